@@ -0,0 +1,108 @@
+//  adaptive split between the small and main queues of S3Random
+//
+//  the size of small is a target that moves at runtime, like the target of
+//  ARC, using two signals the cache already has
+//      a ghost hit:    small evicted an object that came back, small
+//                      should be larger
+//      a hit in main on an object promoted from small: the objects that
+//                      survive small are worth keeping, main should be
+//                      larger
+//  the bytes of both signals are accumulated on the hit path and the
+//  target is only moved when the cache evicts, by their difference
+//  like ARC, which grows T1 by |B2|/|B1| on a B1 hit, a ghost hit weighs
+//  main.n_obj / small.n_obj (at least 1), otherwise the hits in main drown
+//  the ghost hits and small always shrinks to its minimum
+//  main gets the bytes that small does not use
+//
+//
+//  S3RandomAdapt.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_ADAPT_H
+#define S3RANDOM_ADAPT_H
+
+#include "S3RandomIndex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bounds of the small queue as a fraction of the cache size
+#define S3RANDOM_ADAPT_MIN_SMALL_RATIO 0.01
+#define S3RANDOM_ADAPT_MAX_SMALL_RATIO 0.9
+
+typedef struct {
+  bool enabled;
+  int64_t cache_size;
+  int64_t min_small_size;
+  int64_t max_small_size;
+  // bytes of each signal since the last rebalance
+  int64_t ghost_hit_byte;
+  int64_t promoted_hit_byte;
+
+  int64_t n_rebalance;
+} S3Random_adapt_t;
+
+static inline void S3Random_adapt_init(S3Random_adapt_t *adapt, bool enabled,
+                                       int64_t cache_size) {
+  memset(adapt, 0, sizeof(S3Random_adapt_t));
+  adapt->enabled = enabled;
+  adapt->cache_size = cache_size;
+  adapt->min_small_size =
+      (int64_t)(cache_size * S3RANDOM_ADAPT_MIN_SMALL_RATIO);
+  adapt->max_small_size =
+      (int64_t)(cache_size * S3RANDOM_ADAPT_MAX_SMALL_RATIO);
+}
+
+/**
+ * @brief a miss on an object that small evicted recently
+ */
+static inline void S3Random_adapt_ghost_hit(S3Random_adapt_t *adapt,
+                                            const int64_t obj_size) {
+  adapt->ghost_hit_byte += obj_size;
+}
+
+/**
+ * @brief a hit, it only counts if the object is in main and was promoted
+ * from small
+ */
+static inline void S3Random_adapt_promoted_hit(S3Random_adapt_t *adapt,
+                                               const S3Random_entry_t *entry) {
+  if (entry->md.moved_to_main && entry->md.queue == S3RANDOM_MAIN) {
+    adapt->promoted_hit_byte += entry->obj.obj_size;
+  }
+}
+
+/**
+ * @brief move the target of small by the difference of the two signals,
+ * called when the cache evicts, the queues then shrink to their target as
+ * they evict
+ */
+static inline void S3Random_adapt_rebalance(S3Random_adapt_t *adapt,
+                                            S3Random_queue_t *small,
+                                            S3Random_queue_t *main) {
+  if (!adapt->enabled ||
+      (adapt->ghost_hit_byte == 0 && adapt->promoted_hit_byte == 0)) {
+    return;
+  }
+  double ghost_weight =
+      MAX((double)main->n_obj / (double)MAX(small->n_obj, 1), 1.0);
+  int64_t delta = (int64_t)(adapt->ghost_hit_byte * ghost_weight) -
+                  adapt->promoted_hit_byte;
+  adapt->ghost_hit_byte = 0;
+  adapt->promoted_hit_byte = 0;
+  adapt->n_rebalance += 1;
+
+  int64_t small_size = small->cache_size + delta;
+  small_size = MAX(small_size, adapt->min_small_size);
+  small_size = MIN(small_size, adapt->max_small_size);
+  small->cache_size = small_size;
+  main->cache_size = adapt->cache_size - small_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_ADAPT_H
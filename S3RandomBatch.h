@@ -0,0 +1,83 @@
+//  batched get with software prefetching for the S3Random family
+//
+//  on a large cache every request misses in the CPU cache three times, on
+//  the bucket of the index, on the entry the bucket points to, and on the
+//  bucket of the ghost, and one get waits for each of them in turn
+//  get_batch looks ahead in the batch: the request S3RANDOM_BATCH_AHEAD
+//  positions ahead is hashed and its index and ghost buckets are
+//  prefetched, the one half as far ahead reads its (now loaded) bucket and
+//  prefetches its entry, and the current request runs the normal get
+//  the prefetches are only hints, the requests are still resolved one at a
+//  time in order so the hits and the state of the cache are exactly the
+//  ones of calling get on each request
+//
+//
+//  S3RandomBatch.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_BATCH_H
+#define S3RANDOM_BATCH_H
+
+#include "S3RandomGhost.h"
+#include "S3RandomIndex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// how far ahead the buckets are prefetched, the entries are prefetched
+// half as far ahead
+#define S3RANDOM_BATCH_AHEAD 16
+// the hashes of the requests between the current one and the farthest
+// prefetched one, a power of 2 larger than S3RANDOM_BATCH_AHEAD
+#define S3RANDOM_BATCH_RING 32
+
+/**
+ * @brief run get on each request with the buckets and entries of the
+ * next requests prefetched
+ *
+ * @param index the index of the cache
+ * @param ghost the ghost of the cache
+ * @param hits hits[i] is the result of get on reqs[i]
+ */
+static inline void S3Random_get_batch_prefetch(cache_t *cache,
+                                               const S3Random_index_t *index,
+                                               const S3Random_ghost_t *ghost,
+                                               const request_t *reqs,
+                                               const int n, bool *hits) {
+  const int ahead = S3RANDOM_BATCH_AHEAD;
+  const int half = S3RANDOM_BATCH_AHEAD / 2;
+  uint64_t hv[S3RANDOM_BATCH_RING];
+
+  for (int i = 0; i < n && i < ahead; i++) {
+    hv[i] = S3Random_hash(reqs[i].obj_id);
+    S3Random_index_prefetch_bucket(index, hv[i]);
+    S3Random_ghost_prefetch(ghost, hv[i]);
+  }
+  for (int i = 0; i < n && i < half; i++) {
+    S3Random_index_prefetch_entry(index, hv[i]);
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (i + ahead < n) {
+      uint64_t h = S3Random_hash(reqs[i + ahead].obj_id);
+      hv[(i + ahead) & (S3RANDOM_BATCH_RING - 1)] = h;
+      S3Random_index_prefetch_bucket(index, h);
+      S3Random_ghost_prefetch(ghost, h);
+    }
+    if (i + half < n) {
+      S3Random_index_prefetch_entry(
+          index, hv[(i + half) & (S3RANDOM_BATCH_RING - 1)]);
+    }
+    //the index and the ghost may be resized by this get, the prefetches
+    //read their current arrays each time
+    hits[i] = cache->get(cache, &reqs[i]);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_BATCH_H
@@ -0,0 +1,879 @@
+//  microbenchmark of S3Random, S3Randomtwo, S3Randomfreq and S3Randomsharded
+//
+//  every (algorithm, workload, cache size, threads) runs in its own child
+//  process so that its peak RSS is its own, and prints one row
+//      mreq_per_s, ns_per_get      the whole replay, with -T the requests
+//                                  of all the threads over the time the
+//                                  slowest one spent in get, and the mean
+//                                  time of a get
+//      byte_miss_ratio             the bytes of the misses over the bytes
+//                                  requested
+//      ns_per_miss                 a burst of new keys of the mean object
+//                                  size after the replay, each one evicts,
+//                                  so it is the cost of a miss with its
+//                                  eviction
+//      n_evict                     evictions of small and main, from
+//                                  S3Random_stats_get, -1 for the baselines
+//      peak_rss_kb                 getrusage of the child
+//  the rows are JSON lines or CSV so that two versions can be diffed
+//
+//  the workloads are generated in memory by S3RandomWorkload, one batch
+//  at a time, and only the calls to get are timed, the objects of the
+//  named workloads are of size 1 so the cache size is a number of objects
+//      zipf-<alpha>   Zipf over 10x the cache size
+//      scan-hot       70% uniform over a hot set of half the cache, 30% a
+//                     sequential scan over 10x the cache size
+//      loop           a loop over 1.5x the cache size
+//      one-hit        50% keys never seen before, 50% Zipf 1.0
+//      read-mostly    Zipf 1.0 over the cache size, almost every request
+//                     is a hit once the cache is warm
+//      mixed-size     Zipf 0.9 over 10x the cache size, 60% of the objects
+//                     are 1KB, 25% 16KB, 12% 1MB and 3% 100MB, the cache
+//                     holds the cache size objects of the mean size
+//  or any workload of S3RandomWorkload.h with -W, e.g.
+//      -W alpha=0.9,n-obj=100000,size=100@9:10000,shift-every=1000000
+//  or a binary trace with -t, see S3RandomTrace.h, decoded on another
+//  thread while the cache replays it
+//  FIFO and S3FIFO of libCacheSim are the baselines, S3Randomtwo-size is
+//  S3Randomtwo with size-aware=1, S3Randomtwo-last is S3Randomtwo with
+//  score=last-access, S3Randomsharded-two shards S3Randomtwo, the -lock
+//  versions of S3Randomsharded serve the hits under the lock of the shard
+//  (lock-free-hit=0), and the -coarse versions are one shard under one
+//  lock (n-shard=1,lock-free-hit=0)
+//
+//  -T replays each run with every number of threads of the list, the
+//  threads share the cache and split the requests, thread t generates its
+//  own requests from seed + t, only S3Randomsharded is thread-safe so the
+//  other algorithms only run with 1 thread, e.g. the scaling of the
+//  lock-free hits
+//      -a S3Randomsharded,S3Randomsharded-lock,S3Randomsharded-coarse
+//      -w read-mostly
+//      -T 1,2,4,8,16,32,64
+//  -X is the scaling benchmark of one S3Randomsharded instance, the
+//  sharded S3Random and S3Randomtwo against one shard under one lock, on a
+//  workload that misses (zipf-1.0, every miss inserts and evicts under the
+//  lock of its shard) and one that hits (read-mostly), with 100000 objects
+//  and 1 to 64 threads, it is
+//      -a S3Randomsharded,S3Randomsharded-two,S3Randomsharded-coarse,
+//         S3Randomsharded-two-coarse
+//      -w zipf-1.0,read-mostly -s 100000 -T 1,2,4,8,16,32,64
+//  and the options after it replace its lists
+//  -L is the benchmark of a large resident set, a cache of 10M objects in
+//  S3Random, S3Randomtwo and S3Randomfreq and in the FIFO and S3FIFO of
+//  libCacheSim, whose objects are spread over the heap, on one-hit and
+//  loop with 30M requests, both fill the cache and then evict on most
+//  requests, so ns_per_get and ns_per_miss are the cost of an eviction in
+//  a pool far larger than the CPU caches, it is
+//      -a S3Random,S3Randomtwo,S3Randomfreq,FIFO,S3FIFO
+//      -w one-hit,loop -s 10000000 -n 30000000
+//  and the options after it replace its lists
+//
+//  it is a standalone program, built from the root of libCacheSim with
+//      cc -O2 -o S3RandomBench cache/eviction/S3RandomBench.c <the sources
+//      of the S3Random family> -llibCacheSim -lm -lpthread
+//  usage
+//      S3RandomBench [-a algos] [-s cache sizes] [-w workloads]
+//                    [-W workload] [-t trace] [-n requests] [-f json|csv]
+//                    [-S seed] [-B] [-T threads] [-X] [-L] [-G threads]
+//  -B replays the S3Random family with get_batch, see S3RandomBatch.h
+//  lists are separated by commas, the number of requests defaults to 10x
+//  the cache size and at least 1M, a trace is always replayed whole
+//
+//  -G threads stress tests the lock-free ghost instead, see S3RandomGhost.h,
+//  this file builds its ghost with S3RANDOM_GHOST_CONCURRENT=1, the caches
+//  are built without it
+//  for each aging, with and without the filter, the threads insert -n keys
+//  (1M by default) into a ghost 4x larger, then every thread removes all the
+//  keys in the same order so that they race for the same slots, it checks
+//  that no key is claimed twice, that the claims are the keys the ghost
+//  held, and that n_obj is back to 0, it prints one row per ghost and exits
+//  with 1 if a check fails
+//
+//
+//  S3RandomBench.c
+//  libCacheSim
+//
+
+// the ghost of the stress test is shared by its threads
+#define S3RANDOM_GHOST_CONCURRENT 1
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomStats.h"
+#include "S3RandomTrace.h"
+#include "S3RandomWorkload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+cache_t *S3Random_init(const common_cache_params_t ccache_params,
+                       const char *cache_specific_params);
+cache_t *S3Randomtwo_init(const common_cache_params_t ccache_params,
+                          const char *cache_specific_params);
+cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
+                           const char *cache_specific_params);
+void S3Random_get_batch(cache_t *cache, const request_t *reqs, const int n,
+                        bool *hits);
+void S3Randomtwo_get_batch(cache_t *cache, const request_t *reqs, const int n,
+                           bool *hits);
+void S3Randomfreq_get_batch(cache_t *cache, const request_t *reqs,
+                            const int n, bool *hits);
+cache_t *S3Randomsharded_init(const common_cache_params_t ccache_params,
+                              const char *cache_specific_params);
+
+#define S3RANDOM_BENCH_MAX_LIST 32
+// new keys of the miss burst
+#define S3RANDOM_BENCH_MISS_BURST 1000000
+#define S3RANDOM_BENCH_MAX_THREAD 64
+
+typedef struct {
+  const char *name;
+  cache_init_func_ptr init;
+  // the S3Random family reports its evictions
+  bool has_stats;
+  // and has a batched get, NULL for the baselines
+  void (*get_batch)(cache_t *, const request_t *, const int, bool *);
+  // the parameters given to init
+  const char *params;
+  // the threads of -T can share the cache
+  bool thread_safe;
+} S3Random_bench_algo_t;
+
+static const S3Random_bench_algo_t S3Random_bench_algos[] = {
+    {"S3Random", S3Random_init, true, S3Random_get_batch, NULL, false},
+    {"S3Randomtwo", S3Randomtwo_init, true, S3Randomtwo_get_batch, NULL,
+     false},
+    {"S3Randomtwo-size", S3Randomtwo_init, true, S3Randomtwo_get_batch,
+     "size-aware=1", false},
+    {"S3Randomtwo-last", S3Randomtwo_init, true, S3Randomtwo_get_batch,
+     "score=last-access", false},
+    {"S3Randomfreq", S3Randomfreq_init, true, S3Randomfreq_get_batch, NULL,
+     false},
+    {"S3Randomsharded", S3Randomsharded_init, true, NULL, NULL, true},
+    {"S3Randomsharded-lock", S3Randomsharded_init, true, NULL,
+     "lock-free-hit=0", true},
+    {"S3Randomsharded-two", S3Randomsharded_init, true, NULL,
+     "algo=S3Randomtwo", true},
+    {"S3Randomsharded-two-lock", S3Randomsharded_init, true, NULL,
+     "algo=S3Randomtwo,lock-free-hit=0", true},
+    {"S3Randomsharded-coarse", S3Randomsharded_init, true, NULL,
+     "n-shard=1,lock-free-hit=0", true},
+    {"S3Randomsharded-two-coarse", S3Randomsharded_init, true, NULL,
+     "algo=S3Randomtwo,n-shard=1,lock-free-hit=0", true},
+    {"FIFO", FIFO_init, false, NULL, NULL, false},
+    {"S3FIFO", S3FIFO_init, false, NULL, NULL, false},
+};
+
+#define S3RANDOM_BENCH_N_ALGO \
+  (int)(sizeof(S3Random_bench_algos) / sizeof(S3Random_bench_algos[0]))
+
+typedef enum {
+  S3RANDOM_BENCH_ZIPF = 0,
+  S3RANDOM_BENCH_SCAN_HOT = 1,
+  S3RANDOM_BENCH_LOOP = 2,
+  S3RANDOM_BENCH_ONE_HIT = 3,
+  // a description given with -W
+  S3RANDOM_BENCH_CUSTOM = 4,
+  // a binary trace given with -t
+  S3RANDOM_BENCH_TRACE = 5,
+  S3RANDOM_BENCH_MIXED_SIZE = 6,
+  S3RANDOM_BENCH_READ_MOSTLY = 7,
+} S3Random_bench_workload_e;
+
+typedef struct {
+  char name[32];
+  S3Random_bench_workload_e type;
+  double alpha;
+  const char *params;
+} S3Random_bench_workload_t;
+
+typedef struct {
+  const S3Random_bench_algo_t *algos[S3RANDOM_BENCH_MAX_LIST];
+  int n_algo;
+  uint64_t cache_sizes[S3RANDOM_BENCH_MAX_LIST];
+  int n_cache_size;
+  S3Random_bench_workload_t workloads[S3RANDOM_BENCH_MAX_LIST];
+  int n_workload;
+  // the threads of -T
+  int n_threads[S3RANDOM_BENCH_MAX_LIST];
+  int n_n_thread;
+  int64_t n_req;
+  S3Random_stats_format_e format;
+  uint64_t seed;
+  // replay with get_batch when the algorithm has it
+  bool batch;
+  // the threads of the stress test of the ghost, 0 runs the benchmark
+  int n_ghost_thread;
+} S3Random_bench_opts_t;
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                          workloads                            ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief the description of a workload for a cache size, see
+ * S3RandomWorkload.h
+ */
+static void S3Random_bench_workload_spec(
+    const S3Random_bench_workload_t *workload, const int64_t cache_size,
+    const uint64_t seed, S3Random_workload_spec_t *spec) {
+  char workload_str[512];
+  int n = snprintf(workload_str, sizeof(workload_str), "seed=%llu,",
+                   (unsigned long long)seed);
+  char *str = workload_str + n;
+  size_t len = sizeof(workload_str) - n;
+  //the Zipf ranks are drawn by rejection-inversion so that the peak RSS
+  //is the one of the cache
+  switch (workload->type) {
+    case S3RANDOM_BENCH_SCAN_HOT:
+      snprintf(str, len,
+               "alpha=0,n-obj=%lld,scan-ratio=0.3,scan-n-obj=%lld,"
+               "scan-len=%lld",
+               (long long)MAX(cache_size / 2, 1), (long long)(10 * cache_size),
+               (long long)cache_size);
+      break;
+    case S3RANDOM_BENCH_LOOP:
+      snprintf(str, len, "loop-ratio=1,loop-n-obj=%lld",
+               (long long)(cache_size + cache_size / 2));
+      break;
+    case S3RANDOM_BENCH_ONE_HIT:
+      snprintf(str, len,
+               "alpha=1.0,n-obj=%lld,one-hit-ratio=0.5,zipf-method=rejection",
+               (long long)(10 * cache_size));
+      break;
+    case S3RANDOM_BENCH_MIXED_SIZE:
+      snprintf(str, len,
+               "alpha=0.9,n-obj=%lld,zipf-method=rejection,"
+               "size=1024@60:16384@25:1048576@12:104857600@3",
+               (long long)(10 * cache_size));
+      break;
+    case S3RANDOM_BENCH_READ_MOSTLY:
+      snprintf(str, len, "alpha=1.0,n-obj=%lld,zipf-method=rejection",
+               (long long)cache_size);
+      break;
+    case S3RANDOM_BENCH_CUSTOM:
+      snprintf(str, len, "%s", workload->params);
+      break;
+    case S3RANDOM_BENCH_ZIPF:
+    default:
+      snprintf(str, len, "alpha=%g,n-obj=%lld,zipf-method=rejection",
+               workload->alpha, (long long)(10 * cache_size));
+      break;
+  }
+  S3Random_workload_parse(spec, workload_str);
+}
+
+static double S3Random_bench_mean_size(const S3Random_workload_spec_t *spec) {
+  double n_byte = 0, weight = 0;
+  for (int i = 0; i < spec->n_size; i++) {
+    n_byte += (double)spec->size[i] * spec->size_weight[i];
+    weight += spec->size_weight[i];
+  }
+  return n_byte / weight;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                             runs                              ****
+// ****                                                               ****
+// ***********************************************************************
+
+static inline double S3Random_bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief replay a batch of requests through the cache, the bytes requested
+ * are added to n_byte and the bytes of the misses to n_miss_byte
+ *
+ * @param get_batch the batched get of the cache, or NULL to call get
+ * @return the number of hits
+ */
+static int64_t S3Random_bench_replay(
+    cache_t *cache,
+    void (*get_batch)(cache_t *, const request_t *, const int, bool *),
+    const request_t *reqs, const int n, double *elapsed, int64_t *n_byte,
+    int64_t *n_miss_byte) {
+  bool hits[MAX(S3RANDOM_WORKLOAD_BATCH_SIZE, S3RANDOM_TRACE_BATCH_SIZE)];
+  int64_t n_hit = 0;
+  int64_t byte = 0, miss_byte = 0;
+  double start = S3Random_bench_now();
+  if (get_batch != NULL) {
+    get_batch(cache, reqs, n, hits);
+  } else {
+    for (int i = 0; i < n; i++) {
+      hits[i] = cache->get(cache, &reqs[i]);
+    }
+  }
+  *elapsed += S3Random_bench_now() - start;
+  for (int i = 0; i < n; i++) {
+    n_hit += hits[i];
+    byte += reqs[i].obj_size;
+    miss_byte += hits[i] ? 0 : reqs[i].obj_size;
+  }
+  *n_byte += byte;
+  *n_miss_byte += miss_byte;
+  return n_hit;
+}
+
+typedef struct {
+  cache_t *cache;
+  void (*get_batch)(cache_t *, const request_t *, const int, bool *);
+  S3Random_workload_spec_t spec;
+  int64_t n_req;
+  pthread_barrier_t *barrier;
+  double elapsed;
+  int64_t n_hit;
+  int64_t n_byte;
+  int64_t n_miss_byte;
+} S3Random_bench_thread_t;
+
+static void *S3Random_bench_thread(void *arg) {
+  S3Random_bench_thread_t *thread = arg;
+  request_t *reqs = calloc(S3RANDOM_WORKLOAD_BATCH_SIZE, sizeof(request_t));
+  S3Random_workload_t *gen = S3Random_workload_create(&thread->spec);
+  //the threads start together once their generators are built
+  pthread_barrier_wait(thread->barrier);
+  for (int64_t done = 0; done < thread->n_req;
+       done += S3RANDOM_WORKLOAD_BATCH_SIZE) {
+    int n = (int)MIN(thread->n_req - done, S3RANDOM_WORKLOAD_BATCH_SIZE);
+    S3Random_workload_next_batch(gen, reqs, n);
+    thread->n_hit += S3Random_bench_replay(
+        thread->cache, thread->get_batch, reqs, n, &thread->elapsed,
+        &thread->n_byte, &thread->n_miss_byte);
+  }
+  S3Random_workload_free(gen);
+  free(reqs);
+  return NULL;
+}
+
+static void S3Random_bench_run(const S3Random_bench_opts_t *opts,
+                               const S3Random_bench_algo_t *algo,
+                               const S3Random_bench_workload_t *workload,
+                               const uint64_t cache_size, const int n_thread,
+                               FILE *out) {
+  S3Random_workload_spec_t spec;
+  common_cache_params_t ccache_params = default_common_cache_params();
+  ccache_params.cache_size = cache_size;
+  if (workload->type != S3RANDOM_BENCH_TRACE) {
+    S3Random_bench_workload_spec(workload, (int64_t)cache_size, opts->seed,
+                                 &spec);
+  }
+  //the index is sized for the objects the cache holds
+  uint64_t cache_n_obj = cache_size;
+  if (workload->type != S3RANDOM_BENCH_TRACE) {
+    double mean_size = S3Random_bench_mean_size(&spec);
+    if (workload->type == S3RANDOM_BENCH_MIXED_SIZE) {
+      //the cache size is a number of objects of the mean size
+      ccache_params.cache_size = (uint64_t)((double)cache_size * mean_size);
+    }
+    cache_n_obj = (uint64_t)((double)ccache_params.cache_size / mean_size);
+  }
+  int hashpower = 16;
+  while (hashpower < 30 && (1ULL << hashpower) < cache_n_obj) {
+    hashpower += 1;
+  }
+  ccache_params.hashpower = hashpower;
+  cache_t *cache = algo->init(ccache_params, algo->params);
+
+  int64_t n_req = opts->n_req;
+  if (n_req == 0) {
+    n_req = MAX((int64_t)(10 * cache_size), 1000000);
+  }
+
+  request_t *reqs = calloc(S3RANDOM_WORKLOAD_BATCH_SIZE, sizeof(request_t));
+  void (*get_batch)(cache_t *, const request_t *, const int, bool *) =
+      opts->batch ? algo->get_batch : NULL;
+  double elapsed = 0, max_elapsed = 0;
+  int64_t n_hit = 0, n_byte = 0, n_miss_byte = 0;
+  if (workload->type == S3RANDOM_BENCH_TRACE) {
+    //the whole trace, decoded by the producer thread of the trace
+    S3Random_trace_t *trace = S3Random_trace_open(workload->params);
+    S3Random_trace_start(trace);
+    n_req = 0;
+    const S3Random_trace_batch_t *batch;
+    while ((batch = S3Random_trace_next_batch(trace)) != NULL) {
+      n_hit += S3Random_bench_replay(cache, get_batch, batch->reqs,
+                                     batch->n_req, &elapsed, &n_byte,
+                                     &n_miss_byte);
+      n_req += batch->n_req;
+      S3Random_trace_release_batch(trace);
+    }
+    S3Random_trace_close(trace);
+    max_elapsed = elapsed;
+  } else {
+    //the threads split the requests so that every number of threads
+    //replays as many requests
+    pthread_t tids[S3RANDOM_BENCH_MAX_THREAD];
+    S3Random_bench_thread_t threads[S3RANDOM_BENCH_MAX_THREAD];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, n_thread);
+    for (int i = 0; i < n_thread; i++) {
+      memset(&threads[i], 0, sizeof(S3Random_bench_thread_t));
+      threads[i].cache = cache;
+      threads[i].get_batch = get_batch;
+      S3Random_bench_workload_spec(workload, (int64_t)cache_size,
+                                   opts->seed + i, &threads[i].spec);
+      threads[i].n_req = n_req / n_thread + (i < n_req % n_thread);
+      threads[i].barrier = &barrier;
+      pthread_create(&tids[i], NULL, S3Random_bench_thread, &threads[i]);
+    }
+    for (int i = 0; i < n_thread; i++) {
+      pthread_join(tids[i], NULL);
+      elapsed += threads[i].elapsed;
+      n_hit += threads[i].n_hit;
+      n_byte += threads[i].n_byte;
+      n_miss_byte += threads[i].n_miss_byte;
+      max_elapsed = MAX(max_elapsed, threads[i].elapsed);
+    }
+    pthread_barrier_destroy(&barrier);
+  }
+  if (n_req == 0) {
+    ERROR("S3RandomBench %s has no request\n", workload->name);
+    exit(1);
+  }
+
+  //every key of the burst is new, far above the keys of the workloads, and
+  //its objects have the mean size of the replay
+  int64_t burst_obj_size = MAX(n_byte / n_req, 1);
+  int64_t burst_byte = n_byte, burst_miss_byte = 0;
+  double miss_elapsed = 0;
+  int64_t n_miss_burst = MIN(MAX(n_req / 10, 1), S3RANDOM_BENCH_MISS_BURST);
+  for (int64_t done = 0; done < n_miss_burst;
+       done += S3RANDOM_WORKLOAD_BATCH_SIZE) {
+    int n = (int)MIN(n_miss_burst - done, S3RANDOM_WORKLOAD_BATCH_SIZE);
+    for (int i = 0; i < n; i++) {
+      reqs[i].obj_id = (obj_id_t)(done + i + 1) | (1ULL << 63);
+      reqs[i].obj_size = burst_obj_size;
+      reqs[i].op = OP_GET;
+      reqs[i].valid = true;
+    }
+    S3Random_bench_replay(cache, get_batch, reqs, n, &miss_elapsed,
+                          &burst_byte, &burst_miss_byte);
+  }
+
+  int64_t n_evict = -1;
+  if (algo->has_stats) {
+    S3Random_stats_t stats;
+    S3Random_stats_get(cache, &stats);
+    n_evict = stats.n_evict_small + stats.n_evict_main;
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  double miss_ratio = 1 - (double)n_hit / (double)n_req;
+  double byte_miss_ratio = (double)n_miss_byte / (double)MAX(n_byte, 1);
+  double mreq_per_s = (double)n_req / max_elapsed / 1e6;
+  double ns_per_get = elapsed * 1e9 / (double)n_req;
+  double ns_per_miss = miss_elapsed * 1e9 / (double)n_miss_burst;
+  if (opts->format == S3RANDOM_STATS_JSON) {
+    fprintf(out,
+            "{\"algo\": \"%s\", \"workload\": \"%s\", \"cache_size\": %llu, "
+            "\"n_thread\": %d, \"n_req\": %lld, \"miss_ratio\": %.6f, "
+            "\"byte_miss_ratio\": %.6f, \"mreq_per_s\": %.3f, "
+            "\"ns_per_get\": %.1f, \"ns_per_miss\": %.1f, \"n_evict\": %lld, "
+            "\"peak_rss_kb\": %ld}\n",
+            algo->name, workload->name, (unsigned long long)cache_size,
+            n_thread, (long long)n_req, miss_ratio, byte_miss_ratio,
+            mreq_per_s, ns_per_get, ns_per_miss, (long long)n_evict,
+            (long)usage.ru_maxrss);
+  } else {
+    fprintf(out, "%s,%s,%llu,%d,%lld,%.6f,%.6f,%.3f,%.1f,%.1f,%lld,%ld\n",
+            algo->name, workload->name, (unsigned long long)cache_size,
+            n_thread, (long long)n_req, miss_ratio, byte_miss_ratio, mreq_per_s,
+            ns_per_get, ns_per_miss, (long long)n_evict,
+            (long)usage.ru_maxrss);
+  }
+  fflush(out);
+
+  free(reqs);
+  cache->cache_free(cache);
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                      ghost stress test                        ****
+// ****                                                               ****
+// ***********************************************************************
+
+typedef struct {
+  S3Random_ghost_t *ghost;
+  int64_t n_key;
+  int n_thread;
+  int id;
+  // the number of times each key was claimed, shared by the threads
+  int32_t *n_claim;
+  pthread_barrier_t *barrier;
+} S3Random_bench_ghost_thread_t;
+
+static inline uint64_t S3Random_bench_ghost_hv(const int64_t key) {
+  return S3Random_hash((obj_id_t)key + 1);
+}
+
+static void *S3Random_bench_ghost_thread(void *arg) {
+  S3Random_bench_ghost_thread_t *thread = arg;
+  S3Random_ghost_t *ghost = thread->ghost;
+
+  //the keys are split between the threads
+  for (int64_t key = thread->id; key < thread->n_key;
+       key += thread->n_thread) {
+    S3Random_ghost_insert(ghost, S3Random_bench_ghost_hv(key));
+  }
+  //the main thread reads n_obj between the two phases
+  pthread_barrier_wait(thread->barrier);
+  pthread_barrier_wait(thread->barrier);
+
+  //every thread removes every key, only one of them may see the hit
+  for (int64_t key = 0; key < thread->n_key; key++) {
+    if (S3Random_ghost_remove(ghost, S3Random_bench_ghost_hv(key))) {
+      __atomic_fetch_add(&thread->n_claim[key], 1, __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief insert and remove n_key keys with n_thread threads
+ *
+ * @return false if a key was claimed twice, if the claims are not the keys
+ * the ghost held, or if n_obj is not 0 at the end
+ */
+static bool S3Random_bench_ghost_stress(const S3Random_bench_opts_t *opts,
+                                        const S3Random_ghost_aging_e aging,
+                                        const bool filter,
+                                        const int64_t n_key, FILE *out) {
+  int n_thread = opts->n_ghost_thread;
+  S3Random_ghost_t ghost;
+  //large enough that no key expires and few buckets overflow, a key lost
+  //to an overflow is simply not held by the ghost
+  S3Random_ghost_init(&ghost, 4 * n_key, aging, opts->seed, filter);
+  int32_t *n_claim = calloc(n_key, sizeof(int32_t));
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, n_thread + 1);
+
+  pthread_t tids[S3RANDOM_BENCH_MAX_THREAD];
+  S3Random_bench_ghost_thread_t threads[S3RANDOM_BENCH_MAX_THREAD];
+  for (int i = 0; i < n_thread; i++) {
+    threads[i].ghost = &ghost;
+    threads[i].n_key = n_key;
+    threads[i].n_thread = n_thread;
+    threads[i].id = i;
+    threads[i].n_claim = n_claim;
+    threads[i].barrier = &barrier;
+    pthread_create(&tids[i], NULL, S3Random_bench_ghost_thread, &threads[i]);
+  }
+  pthread_barrier_wait(&barrier);
+  int64_t n_held = __atomic_load_n(&ghost.n_obj, __ATOMIC_RELAXED);
+  double start = S3Random_bench_now();
+  pthread_barrier_wait(&barrier);
+  for (int i = 0; i < n_thread; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  double elapsed = S3Random_bench_now() - start;
+  pthread_barrier_destroy(&barrier);
+
+  int64_t n_claimed = 0, n_claimed_twice = 0;
+  for (int64_t key = 0; key < n_key; key++) {
+    n_claimed += n_claim[key];
+    n_claimed_twice += n_claim[key] > 1;
+  }
+  int64_t n_left = ghost.n_obj;
+  bool ok = n_claimed_twice == 0 && n_claimed == n_held && n_left == 0 &&
+            ghost.n_hit == n_claimed;
+  const char *aging_name = aging == S3RANDOM_GHOST_FIFO ? "fifo" : "random";
+  double mremove_per_s = (double)(n_key * n_thread) / elapsed / 1e6;
+  if (opts->format == S3RANDOM_STATS_JSON) {
+    fprintf(out,
+            "{\"aging\": \"%s\", \"filter\": %d, \"n_thread\": %d, "
+            "\"n_key\": %lld, \"n_held\": %lld, \"n_claimed\": %lld, "
+            "\"n_claimed_twice\": %lld, \"n_left\": %lld, "
+            "\"mremove_per_s\": %.3f, \"ok\": %s}\n",
+            aging_name, (int)filter, n_thread, (long long)n_key,
+            (long long)n_held, (long long)n_claimed,
+            (long long)n_claimed_twice, (long long)n_left, mremove_per_s,
+            ok ? "true" : "false");
+  } else {
+    fprintf(out, "%s,%d,%d,%lld,%lld,%lld,%lld,%lld,%.3f,%d\n", aging_name,
+            (int)filter, n_thread, (long long)n_key, (long long)n_held,
+            (long long)n_claimed, (long long)n_claimed_twice,
+            (long long)n_left, mremove_per_s, (int)ok);
+  }
+  fflush(out);
+
+  free(n_claim);
+  S3Random_ghost_free(&ghost);
+  return ok;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                            options                            ****
+// ****                                                               ****
+// ***********************************************************************
+
+static void S3Random_bench_parse_workload(S3Random_bench_workload_t *workload,
+                                          const char *name) {
+  memset(workload, 0, sizeof(S3Random_bench_workload_t));
+  strncpy(workload->name, name, sizeof(workload->name) - 1);
+  if (strncasecmp(name, "zipf-", 5) == 0) {
+    workload->type = S3RANDOM_BENCH_ZIPF;
+    workload->alpha = strtod(name + 5, NULL);
+    if (workload->alpha <= 0) {
+      ERROR("S3RandomBench zipf alpha must be > 0 in %s\n", name);
+      exit(1);
+    }
+  } else if (strcasecmp(name, "scan-hot") == 0) {
+    workload->type = S3RANDOM_BENCH_SCAN_HOT;
+  } else if (strcasecmp(name, "loop") == 0) {
+    workload->type = S3RANDOM_BENCH_LOOP;
+  } else if (strcasecmp(name, "one-hit") == 0) {
+    workload->type = S3RANDOM_BENCH_ONE_HIT;
+  } else if (strcasecmp(name, "mixed-size") == 0) {
+    workload->type = S3RANDOM_BENCH_MIXED_SIZE;
+  } else if (strcasecmp(name, "read-mostly") == 0) {
+    workload->type = S3RANDOM_BENCH_READ_MOSTLY;
+  } else {
+    ERROR("S3RandomBench does not have workload %s\n", name);
+    exit(1);
+  }
+}
+
+/**
+ * @brief split a comma separated list and parse each element
+ *
+ * @return the number of elements
+ */
+static int S3Random_bench_parse_list(const char *list, const char opt,
+                                     S3Random_bench_opts_t *out) {
+  char *str = strdup(list);
+  char *old_str = str;
+  int n = 0;
+  while (str != NULL && str[0] != '\0') {
+    char *v = strsep(&str, ",");
+    if (n == S3RANDOM_BENCH_MAX_LIST) {
+      ERROR("S3RandomBench -%c has more than %d values\n", opt,
+            S3RANDOM_BENCH_MAX_LIST);
+      exit(1);
+    }
+    if (opt == 'a') {
+      int i = 0;
+      while (i < S3RANDOM_BENCH_N_ALGO &&
+             strcasecmp(S3Random_bench_algos[i].name, v) != 0) {
+        i++;
+      }
+      if (i == S3RANDOM_BENCH_N_ALGO) {
+        ERROR("S3RandomBench does not have algo %s\n", v);
+        exit(1);
+      }
+      out->algos[n] = &S3Random_bench_algos[i];
+    } else if (opt == 's') {
+      out->cache_sizes[n] = strtoull(v, NULL, 10);
+      if (out->cache_sizes[n] < 10) {
+        ERROR("S3RandomBench cache size must be >= 10\n");
+        exit(1);
+      }
+    } else if (opt == 'T') {
+      out->n_threads[n] = atoi(v);
+      if (out->n_threads[n] < 1 ||
+          out->n_threads[n] > S3RANDOM_BENCH_MAX_THREAD) {
+        ERROR("S3RandomBench -T must be between 1 and %d threads\n",
+              S3RANDOM_BENCH_MAX_THREAD);
+        exit(1);
+      }
+    } else {
+      S3Random_bench_parse_workload(&out->workloads[n], v);
+    }
+    n += 1;
+  }
+  free(old_str);
+  return n;
+}
+
+static void S3Random_bench_usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-a algos] [-s cache sizes] [-w workloads] [-W workload] "
+          "[-t trace] [-n requests] [-f json|csv] [-S seed] [-B] "
+          "[-T threads] [-X] [-L] [-G threads]\n",
+          prog);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  S3Random_bench_opts_t opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.format = S3RANDOM_STATS_JSON;
+  opts.seed = S3RANDOM_DEFAULT_SEED;
+  opts.n_algo = S3Random_bench_parse_list(
+      "S3Random,S3Randomtwo,S3Randomfreq,S3Randomsharded,FIFO,S3FIFO", 'a',
+      &opts);
+  opts.n_cache_size =
+      S3Random_bench_parse_list("1000,10000,100000,1000000", 's', &opts);
+  opts.n_workload = S3Random_bench_parse_list(
+      "zipf-0.6,zipf-0.8,zipf-1.0,zipf-1.2,scan-hot,loop,one-hit", 'w', &opts);
+  opts.n_n_thread = S3Random_bench_parse_list("1", 'T', &opts);
+
+  int c;
+  while ((c = getopt(argc, argv, "a:s:w:W:t:n:f:S:BT:XLG:")) != -1) {
+    switch (c) {
+      case 'a':
+        opts.n_algo = S3Random_bench_parse_list(optarg, 'a', &opts);
+        break;
+      case 's':
+        opts.n_cache_size = S3Random_bench_parse_list(optarg, 's', &opts);
+        break;
+      case 'w':
+        opts.n_workload = S3Random_bench_parse_list(optarg, 'w', &opts);
+        break;
+      case 'W':
+        //the description has commas so it is one workload of its own
+        memset(&opts.workloads[0], 0, sizeof(S3Random_bench_workload_t));
+        strncpy(opts.workloads[0].name, "custom",
+                sizeof(opts.workloads[0].name) - 1);
+        opts.workloads[0].type = S3RANDOM_BENCH_CUSTOM;
+        opts.workloads[0].params = optarg;
+        opts.n_workload = 1;
+        break;
+      case 't': {
+        memset(&opts.workloads[0], 0, sizeof(S3Random_bench_workload_t));
+        const char *name = strrchr(optarg, '/');
+        strncpy(opts.workloads[0].name, name == NULL ? optarg : name + 1,
+                sizeof(opts.workloads[0].name) - 1);
+        opts.workloads[0].type = S3RANDOM_BENCH_TRACE;
+        opts.workloads[0].params = optarg;
+        opts.n_workload = 1;
+        break;
+      }
+      case 'n':
+        opts.n_req = strtoll(optarg, NULL, 10);
+        break;
+      case 'f': {
+        int format = S3Random_stats_format_parse(optarg);
+        if (format < 0) {
+          S3Random_bench_usage(argv[0]);
+        }
+        opts.format = (S3Random_stats_format_e)format;
+        break;
+      }
+      case 'S':
+        opts.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'B':
+        opts.batch = true;
+        break;
+      case 'T':
+        opts.n_n_thread = S3Random_bench_parse_list(optarg, 'T', &opts);
+        break;
+      case 'X':
+        opts.n_algo = S3Random_bench_parse_list(
+            "S3Randomsharded,S3Randomsharded-two,S3Randomsharded-coarse,"
+            "S3Randomsharded-two-coarse",
+            'a', &opts);
+        opts.n_workload =
+            S3Random_bench_parse_list("zipf-1.0,read-mostly", 'w', &opts);
+        opts.n_cache_size = S3Random_bench_parse_list("100000", 's', &opts);
+        opts.n_n_thread =
+            S3Random_bench_parse_list("1,2,4,8,16,32,64", 'T', &opts);
+        break;
+      case 'L':
+        opts.n_algo = S3Random_bench_parse_list(
+            "S3Random,S3Randomtwo,S3Randomfreq,FIFO,S3FIFO", 'a', &opts);
+        opts.n_workload =
+            S3Random_bench_parse_list("one-hit,loop", 'w', &opts);
+        opts.n_cache_size = S3Random_bench_parse_list("10000000", 's', &opts);
+        opts.n_req = 30000000;
+        break;
+      case 'G':
+        opts.n_ghost_thread = atoi(optarg);
+        if (opts.n_ghost_thread < 1 ||
+            opts.n_ghost_thread > S3RANDOM_BENCH_MAX_THREAD) {
+          ERROR("S3RandomBench -G must be between 1 and %d threads\n",
+                S3RANDOM_BENCH_MAX_THREAD);
+          exit(1);
+        }
+        break;
+      default:
+        S3Random_bench_usage(argv[0]);
+    }
+  }
+
+  if (opts.n_ghost_thread > 0) {
+    int64_t n_key = opts.n_req > 0 ? opts.n_req : 1000000;
+    if (opts.format == S3RANDOM_STATS_CSV) {
+      printf("aging,filter,n_thread,n_key,n_held,n_claimed,n_claimed_twice,"
+             "n_left,mremove_per_s,ok\n");
+    }
+    bool ok = true;
+    for (int aging = S3RANDOM_GHOST_FIFO; aging <= S3RANDOM_GHOST_RANDOM;
+         aging++) {
+      for (int filter = 0; filter <= 1; filter++) {
+        ok &= S3Random_bench_ghost_stress(&opts, (S3Random_ghost_aging_e)aging,
+                                          filter, n_key, stdout);
+      }
+    }
+    if (!ok) {
+      ERROR("S3RandomBench the ghost failed the stress test\n");
+      exit(1);
+    }
+    return 0;
+  }
+
+  for (int t = 0; t < opts.n_n_thread; t++) {
+    if (opts.n_threads[t] > 1 &&
+        opts.workloads[0].type == S3RANDOM_BENCH_TRACE) {
+      ERROR("S3RandomBench a trace is replayed by 1 thread\n");
+      exit(1);
+    }
+  }
+
+  if (opts.format == S3RANDOM_STATS_CSV) {
+    printf("algo,workload,cache_size,n_thread,n_req,miss_ratio,byte_miss_ratio,"
+           "mreq_per_s,ns_per_get,ns_per_miss,n_evict,peak_rss_kb\n");
+  }
+  fflush(stdout);
+
+  for (int w = 0; w < opts.n_workload; w++) {
+    for (int s = 0; s < opts.n_cache_size; s++) {
+      for (int t = 0; t < opts.n_n_thread; t++) {
+        int n_thread = opts.n_threads[t];
+        for (int a = 0; a < opts.n_algo; a++) {
+          if (n_thread > 1 && !opts.algos[a]->thread_safe) {
+            continue;
+          }
+          //a child per run so that the peak RSS is the one of the run
+          pid_t pid = fork();
+          if (pid < 0) {
+            ERROR("S3RandomBench cannot fork\n");
+            exit(1);
+          } else if (pid == 0) {
+            S3Random_bench_run(&opts, opts.algos[a], &opts.workloads[w],
+                               opts.cache_sizes[s], n_thread, stdout);
+            exit(0);
+          }
+          int status;
+          waitpid(pid, &status, 0);
+          if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ERROR("S3RandomBench %s %s %llu %d threads failed\n",
+                  opts.algos[a]->name, opts.workloads[w].name,
+                  (unsigned long long)opts.cache_sizes[s], n_thread);
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
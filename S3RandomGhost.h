@@ -0,0 +1,495 @@
+//  compact ghost queue of the S3Random family
+//
+//  the ghost only needs to answer "was this object evicted from small
+//  recently", so it stores a 32-bit fingerprint of the key instead of a
+//  cache_obj_t, the fingerprints live in buckets of 8 slots (one cache line)
+//  insert, lookup-and-delete and aging are O(1), they only touch one bucket
+//
+//  the ghost is sized by entry count and supports two kinds of aging
+//      FIFO:   a slot is valid while it is one of the last n_entry inserts
+//      random: when the ghost is full a random entry is forgotten
+//
+//  a lookup can match the fingerprint of another key, the expected
+//  false-positive rate is given by S3Random_ghost_fp_rate
+//
+//  a slot packs the fingerprint and the insertion sequence number in one
+//  64-bit word, built with S3RANDOM_GHOST_CONCURRENT=1 the ghost is
+//  lock-free and every change of a slot is a single compare-and-swap
+//      insert:  takes a free, expired or the oldest slot with a CAS and
+//               retries if another thread changed the bucket first
+//      remove:  claims a hit by swapping the slot to 0, only the thread
+//               whose CAS succeeds sees the hit, so an object is never
+//               admitted to main twice
+//  the counters are relaxed atomics
+//  the caches reach their ghost from one thread (a shard of S3Randomsharded
+//  under its lock), so they are built without it and pay plain loads and
+//  stores, the ghost stress test of S3RandomBench is built with it
+//  random aging draws its random numbers from the hash of the insertion
+//  sequence number and the seed of the ghost, so it has no generator state
+//  for the threads to share
+//
+//  an optional counting Bloom filter sits in front of the ghost, most
+//  lookups are for keys that are not in the ghost and the filter answers
+//  them from half the memory of the ghost, so it stays in the CPU cache
+//  longer
+//  the filter is blocked, two ghost buckets share one cache line of 128
+//  4-bit counters and a key sets 3 of them, chosen by its fingerprint, so
+//  the filter is updated from what a slot stores when the slot is
+//  overwritten, expired FIFO slots stay in the filter until they are reused
+//  a counter that reaches 15 is never decremented again
+//  the filter is incremented before a slot is written and decremented
+//  after it is cleared, so it never misses a key of the ghost
+//
+//
+//  S3RandomGhost.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_GHOST_H
+#define S3RANDOM_GHOST_H
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "../../utils/include/mymath.h"
+#include "S3RandomRand.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1 lets many threads share a ghost, see above
+#ifndef S3RANDOM_GHOST_CONCURRENT
+#define S3RANDOM_GHOST_CONCURRENT 0
+#endif
+
+#if S3RANDOM_GHOST_CONCURRENT
+#define S3RANDOM_GHOST_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define S3RANDOM_GHOST_ADD(ptr, n) \
+  __atomic_add_fetch((ptr), (n), __ATOMIC_RELAXED)
+#define S3RANDOM_GHOST_CAS(ptr, expected, desired)                 \
+  __atomic_compare_exchange_n((ptr), (expected), (desired), false, \
+                              __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+// one thread, the value it read is still there
+#define S3RANDOM_GHOST_LOAD(ptr) (*(ptr))
+#define S3RANDOM_GHOST_ADD(ptr, n) (*(ptr) += (n))
+#define S3RANDOM_GHOST_CAS(ptr, expected, desired) (*(ptr) = (desired), true)
+#endif
+
+#define S3RANDOM_GHOST_BUCKET_SIZE 8
+// ghost buckets per block of the filter
+#define S3RANDOM_GHOST_FILTER_BUCKETS 2
+// counters set by a key
+#define S3RANDOM_GHOST_FILTER_K 3
+// a block is a cache line of 8 words of 16 counters
+#define S3RANDOM_GHOST_FILTER_WORDS 8
+
+typedef enum {
+  S3RANDOM_GHOST_FIFO = 0,
+  S3RANDOM_GHOST_RANDOM = 1,
+} S3Random_ghost_aging_e;
+
+typedef struct {
+  // the fingerprint in the high 32 bits and the insertion sequence number
+  // (used by FIFO aging) in the low 32 bits, 0 marks an empty slot
+  uint64_t slot[S3RANDOM_GHOST_BUCKET_SIZE];
+} S3Random_ghost_bucket_t;
+
+typedef struct {
+  S3Random_ghost_bucket_t *buckets;
+  uint64_t n_bucket;
+  // the number of entries the ghost remembers
+  int64_t n_entry;
+  // non-empty slots, with FIFO aging this includes expired slots that
+  // have not been reused yet
+  int64_t n_obj;
+  uint32_t seq;
+  S3Random_ghost_aging_e aging;
+  uint64_t seed;
+  // the counting Bloom filter, NULL when it is off
+  uint64_t *filter;
+  uint64_t n_filter_block;
+
+  int64_t n_insert;
+  int64_t n_lookup;
+  int64_t n_hit;
+  // lookups the filter answered without reading the ghost
+  int64_t n_filter_negative;
+} S3Random_ghost_t;
+
+// the bucket comes from the low 32 bits of the hash, the fingerprint from
+// the high 32 bits so that the two are independent
+static inline uint64_t S3Random_ghost_bucket_id(const S3Random_ghost_t *ghost,
+                                                const uint64_t hv) {
+  return ((hv & 0xffffffffULL) * ghost->n_bucket) >> 32;
+}
+
+static inline S3Random_ghost_bucket_t *S3Random_ghost_bucket(
+    const S3Random_ghost_t *ghost, const uint64_t hv) {
+  return &ghost->buckets[S3Random_ghost_bucket_id(ghost, hv)];
+}
+
+static inline uint32_t S3Random_ghost_fingerprint(const uint64_t hv) {
+  uint32_t fingerprint = (uint32_t)(hv >> 32);
+  return fingerprint == 0 ? 1 : fingerprint;
+}
+
+static inline uint32_t S3Random_ghost_slot_fingerprint(const uint64_t slot) {
+  return (uint32_t)(slot >> 32);
+}
+
+static inline uint32_t S3Random_ghost_slot_seq(const uint64_t slot) {
+  return (uint32_t)slot;
+}
+
+static inline uint64_t S3Random_ghost_slot_load(S3Random_ghost_bucket_t *b,
+                                                int i) {
+  return S3RANDOM_GHOST_LOAD(&b->slot[i]);
+}
+
+/**
+ * @brief whether a slot holds a key the ghost still remembers
+ *
+ * @param seq the current sequence number of the ghost
+ */
+static inline bool S3Random_ghost_slot_valid(const S3Random_ghost_t *ghost,
+                                             const uint64_t slot,
+                                             const uint32_t seq) {
+  if (S3Random_ghost_slot_fingerprint(slot) == 0) {
+    return false;
+  }
+  if (ghost->aging == S3RANDOM_GHOST_FIFO) {
+    return (uint32_t)(seq - S3Random_ghost_slot_seq(slot)) <
+           (uint32_t)ghost->n_entry;
+  }
+  return true;
+}
+
+/**
+ * @brief the word of a block and the shift of the i-th counter of a key
+ */
+static inline uint64_t *S3Random_ghost_filter_word(const S3Random_ghost_t *ghost,
+                                                   const uint64_t bucket_id,
+                                                   const uint32_t fingerprint,
+                                                   const int i, int *shift) {
+  uint32_t counter = (fingerprint >> (7 * i)) & 127;
+  *shift = (int)(counter & 15) * 4;
+  return &ghost->filter[(bucket_id / S3RANDOM_GHOST_FILTER_BUCKETS) *
+                            S3RANDOM_GHOST_FILTER_WORDS +
+                        counter / 16];
+}
+
+/**
+ * @brief add (delta 1) or remove (delta -1) a key from the filter
+ */
+static inline void S3Random_ghost_filter_update(S3Random_ghost_t *ghost,
+                                                const uint64_t bucket_id,
+                                                const uint32_t fingerprint,
+                                                const int delta) {
+  if (ghost->filter == NULL) {
+    return;
+  }
+  for (int i = 0; i < S3RANDOM_GHOST_FILTER_K; i++) {
+    int shift;
+    uint64_t *word =
+        S3Random_ghost_filter_word(ghost, bucket_id, fingerprint, i, &shift);
+    uint64_t old = S3RANDOM_GHOST_LOAD(word);
+    while (true) {
+      uint64_t counter = (old >> shift) & 15;
+      //a saturated counter lost count of its keys, it stays at 15
+      if (counter == 15 || (delta < 0 && counter == 0)) {
+        break;
+      }
+      uint64_t new_word =
+          delta > 0 ? old + (1ULL << shift) : old - (1ULL << shift);
+      if (S3RANDOM_GHOST_CAS(word, &old, new_word)) {
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief false if the key is surely not in the ghost
+ */
+static inline bool S3Random_ghost_filter_test(const S3Random_ghost_t *ghost,
+                                              const uint64_t bucket_id,
+                                              const uint32_t fingerprint) {
+  for (int i = 0; i < S3RANDOM_GHOST_FILTER_K; i++) {
+    int shift;
+    uint64_t *word =
+        S3Random_ghost_filter_word(ghost, bucket_id, fingerprint, i, &shift);
+    if (((S3RANDOM_GHOST_LOAD(word) >> shift) & 15) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief size the ghost to remember n_entry keys
+ *
+ * FIFO aging gets 25% more slots than entries so that buckets rarely
+ * overflow before their entries expire, random aging gets exactly
+ * n_entry slots (rounded up to a bucket)
+ *
+ * @param filter put a counting Bloom filter in front of the ghost
+ */
+static inline void S3Random_ghost_init(S3Random_ghost_t *ghost,
+                                       int64_t n_entry,
+                                       S3Random_ghost_aging_e aging,
+                                       uint64_t seed, bool filter) {
+  memset(ghost, 0, sizeof(S3Random_ghost_t));
+  if (n_entry < 1) {
+    n_entry = 1;
+  }
+  if (n_entry > INT32_MAX) {
+    n_entry = INT32_MAX;
+  }
+  int64_t n_slot = aging == S3RANDOM_GHOST_FIFO ? n_entry + n_entry / 4 : n_entry;
+  ghost->n_bucket =
+      (n_slot + S3RANDOM_GHOST_BUCKET_SIZE - 1) / S3RANDOM_GHOST_BUCKET_SIZE;
+  ghost->buckets = calloc(ghost->n_bucket, sizeof(S3Random_ghost_bucket_t));
+  if (ghost->buckets == NULL) {
+    ERROR("cannot allocate S3Random ghost of %ld entries\n", (long)n_entry);
+  }
+  ghost->n_entry = n_entry;
+  ghost->aging = aging;
+  ghost->seed = seed;
+
+  if (filter) {
+    ghost->n_filter_block =
+        (ghost->n_bucket + S3RANDOM_GHOST_FILTER_BUCKETS - 1) /
+        S3RANDOM_GHOST_FILTER_BUCKETS;
+    size_t n_byte = ghost->n_filter_block * S3RANDOM_GHOST_FILTER_WORDS *
+                    sizeof(uint64_t);
+    //a block is one cache line
+    if (posix_memalign((void **)&ghost->filter, 64, n_byte) != 0) {
+      ERROR("cannot allocate S3Random ghost filter of %ld bytes\n",
+            (long)n_byte);
+    }
+    memset(ghost->filter, 0, n_byte);
+  }
+}
+
+/**
+ * @brief the i-th random number of the insert with sequence number seq
+ */
+static inline uint64_t S3Random_ghost_rand(const S3Random_ghost_t *ghost,
+                                           const uint32_t seq, const int i) {
+  uint64_t x = ghost->seed ^ (((uint64_t)seq << 8) | (uint64_t)i);
+  return S3Random_splitmix64(&x);
+}
+
+static inline void S3Random_ghost_free(S3Random_ghost_t *ghost) {
+  free(ghost->buckets);
+  free(ghost->filter);
+  ghost->buckets = NULL;
+  ghost->filter = NULL;
+  ghost->n_bucket = 0;
+  ghost->n_filter_block = 0;
+}
+
+static inline bool S3Random_ghost_is_init(const S3Random_ghost_t *ghost) {
+  return ghost->buckets != NULL;
+}
+
+/**
+ * @brief start loading the bucket of a key, see S3RandomBatch.h
+ */
+static inline void S3Random_ghost_prefetch(const S3Random_ghost_t *ghost,
+                                           const uint64_t hv) {
+  if (S3Random_ghost_is_init(ghost)) {
+    __builtin_prefetch(S3Random_ghost_bucket(ghost, hv), 0, 3);
+  }
+}
+
+/**
+ * @brief forget one random entry, used by random aging when the ghost is full
+ */
+static inline void S3Random_ghost_evict_rand(S3Random_ghost_t *ghost,
+                                             const uint32_t seq) {
+  for (int attempt = 0;; attempt = (attempt + 1) & 0xff) {
+    uint64_t r = S3Random_ghost_rand(ghost, seq, attempt);
+    uint64_t bucket_id = (r >> 3) % ghost->n_bucket;
+    S3Random_ghost_bucket_t *b = &ghost->buckets[bucket_id];
+    int i = (int)(r & (S3RANDOM_GHOST_BUCKET_SIZE - 1));
+    uint64_t slot = S3Random_ghost_slot_load(b, i);
+    if (slot != 0 &&
+        S3RANDOM_GHOST_CAS(&b->slot[i], &slot, 0)) {
+      S3RANDOM_GHOST_ADD(&ghost->n_obj, -1);
+      S3Random_ghost_filter_update(ghost, bucket_id,
+                                   S3Random_ghost_slot_fingerprint(slot), -1);
+      return;
+    }
+    // another thread emptied it first, the ghost may not be full anymore
+    if (S3RANDOM_GHOST_LOAD(&ghost->n_obj) < ghost->n_entry) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief add one to a counter of the ghost, the counters of the warmup are
+ * reset when it ends
+ */
+static inline void S3Random_ghost_count(S3Random_ghost_t *ghost,
+                                        int64_t *counter) {
+  S3RANDOM_GHOST_ADD(counter, 1);
+}
+
+static inline void S3Random_ghost_insert(S3Random_ghost_t *ghost,
+                                         const uint64_t hv) {
+  DEBUG_ASSERT(S3Random_ghost_is_init(ghost));
+  uint64_t bucket_id = S3Random_ghost_bucket_id(ghost, hv);
+  S3Random_ghost_bucket_t *b = &ghost->buckets[bucket_id];
+  uint32_t seq = S3RANDOM_GHOST_ADD(&ghost->seq, 1);
+  S3Random_ghost_count(ghost, &ghost->n_insert);
+
+  if (ghost->aging == S3RANDOM_GHOST_RANDOM &&
+      S3RANDOM_GHOST_LOAD(&ghost->n_obj) >= ghost->n_entry) {
+    S3Random_ghost_evict_rand(ghost, seq);
+  }
+
+  uint64_t new_slot =
+      ((uint64_t)S3Random_ghost_fingerprint(hv) << 32) | (uint64_t)seq;
+  S3Random_ghost_filter_update(ghost, bucket_id,
+                               S3Random_ghost_fingerprint(hv), 1);
+  while (true) {
+    // take a free or expired slot, else the oldest one (FIFO) or a random
+    // one (random aging) of the bucket
+    int victim = -1;
+    uint64_t slot = 0;
+    for (int i = 0; i < S3RANDOM_GHOST_BUCKET_SIZE; i++) {
+      slot = S3Random_ghost_slot_load(b, i);
+      if (!S3Random_ghost_slot_valid(ghost, slot, seq)) {
+        victim = i;
+        break;
+      }
+    }
+    if (victim == -1) {
+      if (ghost->aging == S3RANDOM_GHOST_FIFO) {
+        victim = 0;
+        slot = S3Random_ghost_slot_load(b, 0);
+        for (int i = 1; i < S3RANDOM_GHOST_BUCKET_SIZE; i++) {
+          uint64_t other = S3Random_ghost_slot_load(b, i);
+          if ((uint32_t)(seq - S3Random_ghost_slot_seq(other)) >
+              (uint32_t)(seq - S3Random_ghost_slot_seq(slot))) {
+            victim = i;
+            slot = other;
+          }
+        }
+      } else {
+        victim = (int)(S3Random_ghost_rand(ghost, seq, 0xff) %
+                       S3RANDOM_GHOST_BUCKET_SIZE);
+        slot = S3Random_ghost_slot_load(b, victim);
+      }
+    }
+
+    // another thread may have changed the slot since we read it
+    if (S3RANDOM_GHOST_CAS(&b->slot[victim], &slot, new_slot)) {
+      if (S3Random_ghost_slot_fingerprint(slot) == 0) {
+        S3RANDOM_GHOST_ADD(&ghost->n_obj, 1);
+      } else {
+        S3Random_ghost_filter_update(
+            ghost, bucket_id, S3Random_ghost_slot_fingerprint(slot), -1);
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * @brief look up a key and delete it if present, with many threads only
+ * the one that claims the slot sees the hit
+ *
+ * @return true if the key (or a key with the same fingerprint) was in the
+ * ghost
+ */
+static inline bool S3Random_ghost_remove(S3Random_ghost_t *ghost,
+                                         const uint64_t hv) {
+  if (!S3Random_ghost_is_init(ghost)) {
+    return false;
+  }
+  S3Random_ghost_count(ghost, &ghost->n_lookup);
+  uint64_t bucket_id = S3Random_ghost_bucket_id(ghost, hv);
+  uint32_t fingerprint = S3Random_ghost_fingerprint(hv);
+  if (ghost->filter != NULL &&
+      !S3Random_ghost_filter_test(ghost, bucket_id, fingerprint)) {
+    S3Random_ghost_count(ghost, &ghost->n_filter_negative);
+    return false;
+  }
+  S3Random_ghost_bucket_t *b = &ghost->buckets[bucket_id];
+  uint32_t seq = S3RANDOM_GHOST_LOAD(&ghost->seq);
+  for (int i = 0; i < S3RANDOM_GHOST_BUCKET_SIZE; i++) {
+    uint64_t slot = S3Random_ghost_slot_load(b, i);
+    if (S3Random_ghost_slot_fingerprint(slot) == fingerprint &&
+        S3Random_ghost_slot_valid(ghost, slot, seq) &&
+        S3RANDOM_GHOST_CAS(&b->slot[i], &slot, 0)) {
+      S3RANDOM_GHOST_ADD(&ghost->n_obj, -1);
+      S3Random_ghost_count(ghost, &ghost->n_hit);
+      S3Random_ghost_filter_update(ghost, bucket_id, fingerprint, -1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief the exact number of bytes used by the filter of the ghost
+ */
+static inline int64_t S3Random_ghost_filter_memory(
+    const S3Random_ghost_t *ghost) {
+  return (int64_t)(ghost->n_filter_block * S3RANDOM_GHOST_FILTER_WORDS *
+                   sizeof(uint64_t));
+}
+
+/**
+ * @brief the exact number of bytes used by the ghost, with its filter
+ */
+static inline int64_t S3Random_ghost_memory(const S3Random_ghost_t *ghost) {
+  return (int64_t)sizeof(S3Random_ghost_t) +
+         (int64_t)(ghost->n_bucket * sizeof(S3Random_ghost_bucket_t)) +
+         S3Random_ghost_filter_memory(ghost);
+}
+
+/**
+ * @brief the lookups the filter let through that were not in the ghost
+ */
+static inline int64_t S3Random_ghost_filter_n_fp(const S3Random_ghost_t *ghost) {
+  if (ghost->filter == NULL) {
+    return 0;
+  }
+  return ghost->n_lookup - ghost->n_filter_negative - ghost->n_hit;
+}
+
+/**
+ * @brief the measured fraction of the keys that are not in the ghost the
+ * filter let through
+ */
+static inline double S3Random_ghost_filter_fp_rate(
+    const S3Random_ghost_t *ghost) {
+  int64_t n_negative = ghost->n_lookup - ghost->n_hit;
+  if (ghost->filter == NULL || n_negative <= 0) {
+    return 0;
+  }
+  return (double)S3Random_ghost_filter_n_fp(ghost) / (double)n_negative;
+}
+
+/**
+ * @brief the expected probability that a lookup of a key that is not in
+ * the ghost reports a hit, a lookup compares the fingerprint with the valid
+ * slots of one bucket and each comparison matches with probability 2^-32
+ */
+static inline double S3Random_ghost_fp_rate(const S3Random_ghost_t *ghost) {
+  if (ghost->n_bucket == 0) {
+    return 0;
+  }
+  double n_obj = (double)MIN(ghost->n_obj, ghost->n_entry);
+  return n_obj / (double)ghost->n_bucket / 4294967296.0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_GHOST_H
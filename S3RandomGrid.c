@@ -0,0 +1,354 @@
+//  replay a trace once through a grid of S3Random configurations
+//  see S3RandomGrid.h
+//
+//
+//  S3RandomGrid.c
+//  libCacheSim
+//
+
+#include <pthread.h>
+
+#include "S3RandomGrid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the fields of a request the caches use, a batch only keeps these
+typedef struct {
+  int64_t clock_time;
+  obj_id_t obj_id;
+  int64_t obj_size;
+} S3Random_grid_req_t;
+
+typedef struct {
+  S3Random_grid_req_t reqs[S3RANDOM_GRID_BATCH_SIZE];
+  int64_t n_req;
+} S3Random_grid_batch_t;
+
+typedef enum {
+  S3RANDOM_GRID_UINT64 = 0,
+  S3RANDOM_GRID_DOUBLE = 1,
+  S3RANDOM_GRID_INT = 2,
+} S3Random_grid_axis_e;
+
+// shared by the reader and the threads of the pool
+typedef struct {
+  S3Random_grid_t *grid;
+  // the reader fills one batch while the threads replay the other
+  S3Random_grid_batch_t *batches[2];
+  int cur;
+  int n_thread;
+  pthread_barrier_t barrier;
+} S3Random_grid_run_t;
+
+typedef struct {
+  S3Random_grid_run_t *run;
+  int id;
+} S3Random_grid_thread_t;
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                        grid description                       ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief split the colon separated values of an axis
+ *
+ * @return the number of values
+ */
+static int S3Random_grid_parse_axis(const char *key, char *value,
+                                    void *axis,
+                                    const S3Random_grid_axis_e type) {
+  int n = 0;
+  while (value != NULL && value[0] != '\0') {
+    char *v = strsep(&value, ":");
+    if (n == S3RANDOM_GRID_MAX_AXIS) {
+      ERROR("S3Random grid %s has more than %d values\n", key,
+            S3RANDOM_GRID_MAX_AXIS);
+      exit(1);
+    }
+    if (type == S3RANDOM_GRID_DOUBLE) {
+      ((double *)axis)[n] = strtod(v, NULL);
+    } else if (type == S3RANDOM_GRID_INT) {
+      ((int *)axis)[n] = atoi(v);
+    } else {
+      ((uint64_t *)axis)[n] = strtoull(v, NULL, 10);
+    }
+    n += 1;
+  }
+  if (n == 0) {
+    ERROR("S3Random grid %s has no value\n", key);
+    exit(1);
+  }
+  return n;
+}
+
+void S3Random_grid_parse(S3Random_grid_spec_t *spec, const char *grid_str) {
+  memset(spec, 0, sizeof(S3Random_grid_spec_t));
+  strncpy(spec->algo, "S3Random", sizeof(spec->algo) - 1);
+
+  char *params_str = strdup(grid_str);
+  char *old_params_str = params_str;
+
+  while (params_str != NULL && params_str[0] != '\0') {
+    /* different axes are separated by comma,
+     * key and values are separated by = */
+    char *key = strsep((char **)&params_str, "=");
+    char *value = strsep((char **)&params_str, ",");
+
+    // skip the white space
+    while (params_str != NULL && *params_str == ' ') {
+      params_str++;
+    }
+
+    if (value == NULL) {
+      ERROR("S3Random grid %s has no value\n", key);
+      exit(1);
+    } else if (strcasecmp(key, "algo") == 0) {
+      if (strcasecmp(value, "S3Random") != 0 &&
+          strcasecmp(value, "S3Randomtwo") != 0 &&
+          strcasecmp(value, "S3Randomfreq") != 0) {
+        ERROR("S3Random grid does not support algo %s\n", value);
+        exit(1);
+      }
+      strncpy(spec->algo, value, sizeof(spec->algo) - 1);
+    } else if (strcasecmp(key, "cache-size") == 0) {
+      spec->n_cache_size =
+          S3Random_grid_parse_axis(key, value, spec->cache_size,
+                                   S3RANDOM_GRID_UINT64);
+    } else if (strcasecmp(key, "small-size-ratio") == 0) {
+      spec->n_small_size_ratio = S3Random_grid_parse_axis(
+          key, value, spec->small_size_ratio, S3RANDOM_GRID_DOUBLE);
+    } else if (strcasecmp(key, "ghost-size-ratio") == 0) {
+      spec->n_ghost_size_ratio = S3Random_grid_parse_axis(
+          key, value, spec->ghost_size_ratio, S3RANDOM_GRID_DOUBLE);
+    } else if (strcasecmp(key, "move-to-main-threshold") == 0) {
+      spec->n_threshold =
+          S3Random_grid_parse_axis(key, value, spec->threshold,
+                                   S3RANDOM_GRID_INT);
+    } else {
+      ERROR("S3Random grid does not have axis %s\n", key);
+      exit(1);
+    }
+  }
+  free(old_params_str);
+
+  if (spec->n_cache_size == 0) {
+    ERROR("S3Random grid needs at least one cache-size\n");
+    exit(1);
+  }
+  //the axes that are not given get the defaults of the algorithms
+  if (spec->n_small_size_ratio == 0) {
+    spec->small_size_ratio[spec->n_small_size_ratio++] = 0.1;
+  }
+  if (spec->n_ghost_size_ratio == 0) {
+    spec->ghost_size_ratio[spec->n_ghost_size_ratio++] = 0.9;
+  }
+  if (spec->n_threshold == 0) {
+    spec->threshold[spec->n_threshold++] = 2;
+  }
+}
+
+S3Random_grid_t *S3Random_grid_create(const S3Random_grid_spec_t *spec,
+                                      common_cache_params_t ccache_params) {
+  cache_init_func_ptr init = S3Random_init;
+  bool use_threshold = false;
+  if (strcasecmp(spec->algo, "S3Randomtwo") == 0) {
+    init = S3Randomtwo_init;
+  } else if (strcasecmp(spec->algo, "S3Randomfreq") == 0) {
+    init = S3Randomfreq_init;
+    use_threshold = true;
+  }
+  //only S3Randomfreq has a threshold, the others get one cell per value
+  int n_threshold = use_threshold ? spec->n_threshold : 1;
+
+  S3Random_grid_t *grid = malloc(sizeof(S3Random_grid_t));
+  memcpy(&grid->spec, spec, sizeof(S3Random_grid_spec_t));
+  grid->n_cell = spec->n_cache_size * spec->n_small_size_ratio *
+                 spec->n_ghost_size_ratio * n_threshold;
+  grid->cells = calloc(grid->n_cell, sizeof(S3Random_grid_cell_t));
+
+  int n = 0;
+  for (int i = 0; i < spec->n_cache_size; i++) {
+    for (int j = 0; j < spec->n_small_size_ratio; j++) {
+      for (int k = 0; k < spec->n_ghost_size_ratio; k++) {
+        for (int l = 0; l < n_threshold; l++) {
+          S3Random_grid_cell_t *cell = &grid->cells[n++];
+          cell->cache_size = spec->cache_size[i];
+          cell->small_size_ratio = spec->small_size_ratio[j];
+          cell->ghost_size_ratio = spec->ghost_size_ratio[k];
+          cell->threshold = use_threshold ? spec->threshold[l] : 0;
+
+          int len = snprintf(cell->cache_params, sizeof(cell->cache_params),
+                             "small-size-ratio=%g,ghost-size-ratio=%g",
+                             cell->small_size_ratio, cell->ghost_size_ratio);
+          if (use_threshold) {
+            snprintf(cell->cache_params + len,
+                     sizeof(cell->cache_params) - len,
+                     ",move-to-main-threshold=%d", cell->threshold);
+          }
+          ccache_params.cache_size = cell->cache_size;
+          cell->cache = init(ccache_params, cell->cache_params);
+        }
+      }
+    }
+  }
+  return grid;
+}
+
+void S3Random_grid_free(S3Random_grid_t *grid) {
+  for (int i = 0; i < grid->n_cell; i++) {
+    grid->cells[i].cache->cache_free(grid->cells[i].cache);
+  }
+  free(grid->cells);
+  free(grid);
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                          simulation                           ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief decode the next batch of the trace
+ */
+static void S3Random_grid_read_batch(reader_t *reader, request_t *req,
+                                     S3Random_grid_batch_t *batch) {
+  batch->n_req = 0;
+  while (batch->n_req < S3RANDOM_GRID_BATCH_SIZE &&
+         read_one_req(reader, req) == 0) {
+    S3Random_grid_req_t *r = &batch->reqs[batch->n_req++];
+    r->clock_time = req->clock_time;
+    r->obj_id = req->obj_id;
+    r->obj_size = req->obj_size;
+  }
+}
+
+/**
+ * @brief a thread of the pool replays each batch through its caches, one
+ * cache at a time so that the cache stays hot for the whole batch
+ */
+static void *S3Random_grid_thread(void *arg) {
+  S3Random_grid_thread_t *thread = (S3Random_grid_thread_t *)arg;
+  S3Random_grid_run_t *run = thread->run;
+  S3Random_grid_t *grid = run->grid;
+  request_t *req = new_request();
+
+  while (true) {
+    //wait for the reader to publish a batch
+    pthread_barrier_wait(&run->barrier);
+    S3Random_grid_batch_t *batch = run->batches[run->cur];
+    if (batch->n_req == 0) {
+      break;
+    }
+
+    for (int i = thread->id; i < grid->n_cell; i += run->n_thread) {
+      S3Random_grid_cell_t *cell = &grid->cells[i];
+      cache_t *cache = cell->cache;
+      //the cells of different threads share cache lines, so we count
+      //locally and update the cell once per batch
+      int64_t n_miss = 0, n_byte = 0, n_miss_byte = 0;
+      for (int64_t j = 0; j < batch->n_req; j++) {
+        S3Random_grid_req_t *r = &batch->reqs[j];
+        req->clock_time = r->clock_time;
+        req->obj_id = r->obj_id;
+        req->obj_size = r->obj_size;
+        req->valid = true;
+
+        bool hit = cache->get(cache, req);
+        n_byte += r->obj_size;
+        if (!hit) {
+          n_miss += 1;
+          n_miss_byte += r->obj_size;
+        }
+      }
+      cell->n_req += batch->n_req;
+      cell->n_miss += n_miss;
+      cell->n_byte += n_byte;
+      cell->n_miss_byte += n_miss_byte;
+    }
+
+    //the batch is done
+    pthread_barrier_wait(&run->barrier);
+  }
+
+  free_request(req);
+  return NULL;
+}
+
+void S3Random_grid_run(S3Random_grid_t *grid, reader_t *reader, int n_thread) {
+  if (n_thread < 1) {
+    n_thread = 1;
+  }
+  if (n_thread > grid->n_cell) {
+    n_thread = grid->n_cell;
+  }
+
+  S3Random_grid_run_t run;
+  run.grid = grid;
+  run.batches[0] = malloc(sizeof(S3Random_grid_batch_t));
+  run.batches[1] = malloc(sizeof(S3Random_grid_batch_t));
+  run.cur = 0;
+  run.n_thread = n_thread;
+  //the threads of the pool and the reader
+  pthread_barrier_init(&run.barrier, NULL, n_thread + 1);
+
+  pthread_t *tids = malloc(sizeof(pthread_t) * n_thread);
+  S3Random_grid_thread_t *threads =
+      malloc(sizeof(S3Random_grid_thread_t) * n_thread);
+  for (int i = 0; i < n_thread; i++) {
+    threads[i].run = &run;
+    threads[i].id = i;
+    pthread_create(&tids[i], NULL, S3Random_grid_thread, &threads[i]);
+  }
+
+  request_t *req = new_request();
+  S3Random_grid_read_batch(reader, req, run.batches[run.cur]);
+  while (true) {
+    //publish the current batch, an empty batch stops the threads
+    pthread_barrier_wait(&run.barrier);
+    if (run.batches[run.cur]->n_req == 0) {
+      break;
+    }
+    //decode the next batch while the threads replay the current one
+    S3Random_grid_read_batch(reader, req, run.batches[1 - run.cur]);
+    pthread_barrier_wait(&run.barrier);
+    run.cur = 1 - run.cur;
+  }
+  free_request(req);
+
+  for (int i = 0; i < n_thread; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  pthread_barrier_destroy(&run.barrier);
+  free(tids);
+  free(threads);
+  free(run.batches[0]);
+  free(run.batches[1]);
+}
+
+void S3Random_grid_print(const S3Random_grid_t *grid, FILE *out) {
+  fprintf(out, "%-14s %14s %8s %8s %9s %12s %12s %10s %15s\n", "algo",
+          "cache_size", "small", "ghost", "threshold", "n_req", "n_miss",
+          "miss_ratio", "byte_miss_ratio");
+  for (int i = 0; i < grid->n_cell; i++) {
+    const S3Random_grid_cell_t *cell = &grid->cells[i];
+    double miss_ratio =
+        cell->n_req == 0 ? 0 : (double)cell->n_miss / (double)cell->n_req;
+    double byte_miss_ratio =
+        cell->n_byte == 0 ? 0
+                          : (double)cell->n_miss_byte / (double)cell->n_byte;
+    fprintf(out, "%-14s %14lu %8.4f %8.4f %9d %12ld %12ld %10.4f %15.4f\n",
+            grid->spec.algo, (unsigned long)cell->cache_size,
+            cell->small_size_ratio, cell->ghost_size_ratio, cell->threshold,
+            (long)cell->n_req, (long)cell->n_miss, miss_ratio,
+            byte_miss_ratio);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
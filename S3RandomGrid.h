@@ -0,0 +1,109 @@
+//  simulate a grid of S3Random configurations in one pass over a trace
+//
+//  the trace is decoded once, in batches, and every batch is replayed by
+//  all the caches of the grid, the caches are split between the threads of
+//  a pool so each cache is only touched by one thread
+//  the reader decodes the next batch while the threads replay the current
+//  one
+//
+//  a grid is the cartesian product of the values given for each axis
+//      algo=S3Randomfreq,cache-size=1000:10000,small-size-ratio=0.05:0.1,
+//      ghost-size-ratio=0.5:0.9,move-to-main-threshold=1:2
+//  the values of an axis are separated by colons, move-to-main-threshold
+//  is only used by S3Randomfreq
+//
+//
+//  S3RandomGrid.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_GRID_H
+#define S3RANDOM_GRID_H
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "../../include/libCacheSim/reader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the most values on one axis of the grid
+#define S3RANDOM_GRID_MAX_AXIS 16
+// requests decoded at once
+#define S3RANDOM_GRID_BATCH_SIZE 65536
+
+cache_t *S3Random_init(const common_cache_params_t ccache_params,
+                       const char *cache_specific_params);
+cache_t *S3Randomtwo_init(const common_cache_params_t ccache_params,
+                          const char *cache_specific_params);
+cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
+                           const char *cache_specific_params);
+
+typedef struct {
+  char algo[32];
+  uint64_t cache_size[S3RANDOM_GRID_MAX_AXIS];
+  int n_cache_size;
+  double small_size_ratio[S3RANDOM_GRID_MAX_AXIS];
+  int n_small_size_ratio;
+  double ghost_size_ratio[S3RANDOM_GRID_MAX_AXIS];
+  int n_ghost_size_ratio;
+  int threshold[S3RANDOM_GRID_MAX_AXIS];
+  int n_threshold;
+} S3Random_grid_spec_t;
+
+// one configuration of the grid and its results
+typedef struct {
+  cache_t *cache;
+  uint64_t cache_size;
+  double small_size_ratio;
+  double ghost_size_ratio;
+  int threshold;
+  // the parameters the cache was created with, the cache keeps a pointer
+  char cache_params[128];
+
+  int64_t n_req;
+  int64_t n_miss;
+  int64_t n_byte;
+  int64_t n_miss_byte;
+} S3Random_grid_cell_t;
+
+typedef struct {
+  S3Random_grid_spec_t spec;
+  S3Random_grid_cell_t *cells;
+  int n_cell;
+} S3Random_grid_t;
+
+/**
+ * @brief parse a grid description, an axis that is not given keeps the
+ * default of the algorithm
+ */
+void S3Random_grid_parse(S3Random_grid_spec_t *spec, const char *grid_str);
+
+/**
+ * @brief create one cache for each configuration of the grid
+ *
+ * @param ccache_params hashpower and default ttl of all the caches, the
+ * cache size is taken from the grid
+ */
+S3Random_grid_t *S3Random_grid_create(const S3Random_grid_spec_t *spec,
+                                      common_cache_params_t ccache_params);
+
+/**
+ * @brief replay the trace once through all the caches of the grid
+ *
+ * @param n_thread the size of the thread pool, at most one per cache
+ */
+void S3Random_grid_run(S3Random_grid_t *grid, reader_t *reader, int n_thread);
+
+/**
+ * @brief print the miss ratio and byte miss ratio of each configuration
+ */
+void S3Random_grid_print(const S3Random_grid_t *grid, FILE *out);
+
+void S3Random_grid_free(S3Random_grid_t *grid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_GRID_H
@@ -0,0 +1,638 @@
+//  one index shared by the small and main queues of S3Random
+//
+//  the resident objects are stored by value in one dense array (the pool)
+//  removing an object moves the last entry of the pool into the hole, so
+//  the pool never has holes and the entries sit in contiguous memory
+//
+//  the hash table chains are slot numbers in the pool, every entry carries
+//  a tag telling which queue (small/main) it is on
+//  a request hashes the obj_id once and probes one bucket, the same hash is
+//  then used for the ghost (see S3RandomGhost.h)
+//
+//  each queue is a dense array of slots, so a random victim is one index
+//  into the queue and one into the pool, the position kept in the entry
+//  makes removal O(1)
+//  promotion (small -> main) only flips the tag and moves the slot number
+//  between two queues, the entry stays where it is in the pool
+//
+//  pointers to entries are only valid until the next insert or remove
+//
+//  the last access time is only read by S3Randomtwo with
+//  score=last-access, so it is not in the entry but in a side array of the
+//  index with one time per slot of the pool (last_access), allocated only
+//  when the index is created with track_access, a removal moves the time
+//  of the last entry with it
+//
+//  the index is the first member of the params of every variant, so
+//  S3Randomsharded can reach it from cache->eviction_params
+//
+//  the pool is the arena of the objects of a cache, and its free list is
+//  its tail, since a removal moves the last entry into the hole the free
+//  slots are always [n_entry, capacity) and an insert takes the first one,
+//  an object promoted to main keeps its slot and the ghost keeps only a
+//  fingerprint, so no object is allocated or freed on its own
+//  the pool, the buckets and the slots of the queues are the only memory
+//  of a cache and they are only allocated when they double, so the steady
+//  state does not call malloc, with hugepage they are mapped on huge pages
+//  (explicit ones if the system reserved some, transparent ones
+//  otherwise) since every access to them is random and a large cache
+//  would miss in the TLB on most of them
+//
+//  an object inserted with a ttl expires at clock_time + ttl (exp_time of
+//  libCacheSim), the caches reclaim an expired object when it is found
+//  and look for expired objects (S3Random_queue_rand_expired) before they
+//  evict a live one, only while some entry of the index has a ttl
+//
+//
+//  S3RandomIndex.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_INDEX_H
+#define S3RANDOM_INDEX_H
+
+#include <sys/mman.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "../../utils/include/mymath.h"
+#include "S3RandomRand.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define S3RANDOM_NO_SLOT UINT32_MAX
+#define S3RANDOM_HUGE_PAGE_SIZE (2 << 20)
+// the arrays mapped on huge pages start after a header that keeps the
+// size of the mapping, it keeps the array aligned to a cache line
+#define S3RANDOM_MAP_HEADER 64
+// the access counter saturates at 3, it has 2 bits
+#define S3RANDOM_MAX_FREQ 3
+// the random entries every variant looks at for an expired one before it
+// evicts, it does not follow n_sample so a larger sample does not cost
+// more draws on every eviction of a cache with ttl
+#define S3RANDOM_TTL_N_PROBE 4
+
+typedef enum {
+  S3RANDOM_SMALL = 0,
+  S3RANDOM_MAIN = 1,
+  S3RANDOM_N_QUEUE = 2,
+} S3Random_queue_e;
+
+// the metadata the eviction of an object needs, packed in one byte, the
+// byte lets the lock-free hits of S3Randomsharded update it with a CAS
+typedef union {
+  struct {
+    // S3Random_queue_e of the queue the entry is on
+    uint8_t queue : 1;
+    // promoted from small, see S3RandomAdapt.h
+    uint8_t moved_to_main : 1;
+    // hits since the last eviction check, used by S3Random and S3Randomfreq
+    uint8_t freq : 2;
+    // hit while in small, used by S3Randomtwo
+    uint8_t promoted : 1;
+  };
+  uint8_t byte;
+} S3Random_md_t;
+
+// bytes of metadata of an object, the packed byte
+#define S3RANDOM_OBJ_MD_SIZE ((int32_t)sizeof(S3Random_md_t))
+// and the last access time for an index that tracks it
+#define S3RANDOM_ACCESS_MD_SIZE ((int32_t)sizeof(int64_t))
+
+typedef struct {
+  // find and insert return &entry->obj
+  cache_obj_t obj;
+  // next slot in the chain of the index
+  uint32_t next;
+  // position of the slot in the array of its queue
+  uint32_t pos;
+  S3Random_md_t md;
+} S3Random_entry_t;
+
+struct S3Random_index;
+
+typedef struct {
+  struct S3Random_index *index;
+  uint32_t *slots;
+  int64_t n_obj;
+  int64_t capacity;
+  int64_t occupied_byte;
+  int64_t cache_size;
+  uint8_t id;
+  // draws the random victims of this queue
+  S3Random_rng_t rng;
+} S3Random_queue_t;
+
+typedef struct S3Random_index {
+  // the pool of resident entries
+  S3Random_entry_t *entries;
+  // the last access time of each slot of the pool, NULL unless the index
+  // tracks it
+  int64_t *last_access;
+  bool track_access;
+  int64_t n_entry;
+  int64_t capacity;
+  // the first slot of each chain
+  uint32_t *buckets;
+  uint64_t mask;
+  // the queues, to fix the position of an entry moved by a removal
+  S3Random_queue_t *queues[S3RANDOM_N_QUEUE];
+  // counted with the size of each object when consider_obj_metadata is set
+  int32_t obj_md_size;
+  // the arrays are mapped on huge pages
+  bool hugepage;
+  // the entries with an expiration time, expired entries are only looked
+  // for when there is one
+  int64_t n_ttl;
+  // the clock time of the last request, an entry whose expiration time is
+  // before it has expired
+  int64_t clock_time;
+  // the virtual time of S3Randomtwo, one tick per request, it is advanced
+  // with an atomic add so the hits S3Randomsharded serves without the lock
+  // and the requests served under it count on the same clock
+  int64_t vtime;
+} S3Random_index_t;
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                          index                                ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief allocate an array of the index, on huge pages with hugepage
+ *
+ * @return NULL if there is no memory
+ */
+static inline void *S3Random_index_alloc(const S3Random_index_t *index,
+                                         const size_t n_byte) {
+  if (!index->hugepage) {
+    return malloc(n_byte);
+  }
+  size_t map_byte = (n_byte + S3RANDOM_MAP_HEADER + S3RANDOM_HUGE_PAGE_SIZE -
+                     1) & ~((size_t)S3RANDOM_HUGE_PAGE_SIZE - 1);
+  void *map = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  map = mmap(NULL, map_byte, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (map == MAP_FAILED) {
+    //no huge page is reserved, the kernel gives transparent ones
+    map = mmap(NULL, map_byte, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+      return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(map, map_byte, MADV_HUGEPAGE);
+#endif
+  }
+  *(size_t *)map = map_byte;
+  return (char *)map + S3RANDOM_MAP_HEADER;
+}
+
+static inline void S3Random_index_dealloc(const S3Random_index_t *index,
+                                          void *array) {
+  if (array == NULL) {
+    return;
+  }
+  if (!index->hugepage) {
+    free(array);
+    return;
+  }
+  void *map = (char *)array - S3RANDOM_MAP_HEADER;
+  munmap(map, *(size_t *)map);
+}
+
+/**
+ * @brief grow an array of the index, the first old_byte bytes are kept
+ *
+ * @return NULL if there is no memory, the old array is then untouched
+ */
+static inline void *S3Random_index_realloc(const S3Random_index_t *index,
+                                           void *array, const size_t old_byte,
+                                           const size_t new_byte) {
+  if (!index->hugepage) {
+    return realloc(array, new_byte);
+  }
+  void *new_array = S3Random_index_alloc(index, new_byte);
+  if (new_array != NULL && array != NULL) {
+    memcpy(new_array, array, old_byte);
+    S3Random_index_dealloc(index, array);
+  }
+  return new_array;
+}
+
+static inline uint64_t S3Random_hash(const obj_id_t obj_id) {
+  // splitmix64 finalizer
+  uint64_t hv = obj_id + 0x9e3779b97f4a7c15ULL;
+  hv = (hv ^ (hv >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hv = (hv ^ (hv >> 27)) * 0x94d049bb133111ebULL;
+  return hv ^ (hv >> 31);
+}
+
+/**
+ * @param obj_md_size the obj_md_size of the cache
+ * @param hugepage map the arrays of the index and its queues on huge pages
+ * @param track_access keep the last access time of every entry
+ */
+static inline void S3Random_index_init(S3Random_index_t *index,
+                                       int hashpower, int32_t obj_md_size,
+                                       bool hugepage, bool track_access) {
+  if (hashpower <= 0 || hashpower > 31) {
+    hashpower = 16;
+  }
+  memset(index, 0, sizeof(S3Random_index_t));
+  index->obj_md_size = obj_md_size;
+  index->hugepage = hugepage;
+  index->track_access = track_access;
+  index->mask = (1ULL << hashpower) - 1;
+  index->buckets =
+      S3Random_index_alloc(index, sizeof(uint32_t) * (index->mask + 1));
+  if (index->buckets == NULL) {
+    ERROR("cannot allocate S3Random index of %lu buckets\n",
+          (unsigned long)(index->mask + 1));
+  }
+  memset(index->buckets, 0xff, sizeof(uint32_t) * (index->mask + 1));
+}
+
+static inline void S3Random_index_free(S3Random_index_t *index) {
+  S3Random_index_dealloc(index, index->entries);
+  S3Random_index_dealloc(index, index->last_access);
+  S3Random_index_dealloc(index, index->buckets);
+  index->entries = NULL;
+  index->last_access = NULL;
+  index->buckets = NULL;
+}
+
+/**
+ * @brief advance the virtual time by one request
+ *
+ * @return the time of this request
+ */
+static inline int64_t S3Random_index_tick(S3Random_index_t *index) {
+  return __atomic_add_fetch(&index->vtime, 1, __ATOMIC_RELAXED);
+}
+
+static inline int64_t S3Random_index_vtime(const S3Random_index_t *index) {
+  return __atomic_load_n(&index->vtime, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t S3Random_index_slot(const S3Random_index_t *index,
+                                           const S3Random_entry_t *entry) {
+  return (uint32_t)(entry - index->entries);
+}
+
+/**
+ * @brief the last access time of an entry, the index must track it
+ */
+static inline int64_t *S3Random_index_last_access(
+    const S3Random_index_t *index, const S3Random_entry_t *entry) {
+  DEBUG_ASSERT(index->last_access != NULL);
+  return &index->last_access[S3Random_index_slot(index, entry)];
+}
+
+/**
+ * @brief set the last access time of an entry if the index tracks it
+ */
+static inline void S3Random_index_touch(S3Random_index_t *index,
+                                        const S3Random_entry_t *entry,
+                                        const int64_t vtime) {
+  if (index->last_access != NULL) {
+    index->last_access[S3Random_index_slot(index, entry)] = vtime;
+  }
+}
+
+/**
+ * @brief find an entry, the only hash table probe of a request
+ *
+ * @param hv S3Random_hash(obj_id), computed once per request
+ * @return the entry (on any queue) or NULL
+ */
+static inline S3Random_entry_t *S3Random_index_find(
+    const S3Random_index_t *index, const obj_id_t obj_id, const uint64_t hv) {
+  uint32_t slot = index->buckets[hv & index->mask];
+  while (slot != S3RANDOM_NO_SLOT) {
+    S3Random_entry_t *entry = &index->entries[slot];
+    if (entry->obj.obj_id == obj_id) {
+      return entry;
+    }
+    slot = entry->next;
+  }
+  return NULL;
+}
+
+/**
+ * @brief start loading the bucket of a key, see S3RandomBatch.h
+ */
+static inline void S3Random_index_prefetch_bucket(
+    const S3Random_index_t *index, const uint64_t hv) {
+  __builtin_prefetch(&index->buckets[hv & index->mask], 0, 3);
+}
+
+/**
+ * @brief start loading the first entry of the chain of a key, the bucket
+ * should already be in the cache
+ */
+static inline void S3Random_index_prefetch_entry(
+    const S3Random_index_t *index, const uint64_t hv) {
+  uint32_t slot = index->buckets[hv & index->mask];
+  if (slot != S3RANDOM_NO_SLOT) {
+    __builtin_prefetch(&index->entries[slot], 0, 3);
+  }
+}
+
+/**
+ * @brief find the link that points to slot, a bucket or the next of the
+ * previous entry in the chain
+ */
+static inline uint32_t *S3Random_index_link(S3Random_index_t *index,
+                                            const uint32_t slot) {
+  S3Random_entry_t *entry = &index->entries[slot];
+  uint32_t *link =
+      &index->buckets[S3Random_hash(entry->obj.obj_id) & index->mask];
+  while (*link != slot) {
+    DEBUG_ASSERT(*link != S3RANDOM_NO_SLOT);
+    link = &index->entries[*link].next;
+  }
+  return link;
+}
+
+static void S3Random_index_expand(S3Random_index_t *index) {
+  uint64_t new_mask = index->mask * 2 + 1;
+  uint32_t *new_buckets =
+      S3Random_index_alloc(index, sizeof(uint32_t) * (new_mask + 1));
+  if (new_buckets == NULL) {
+    ERROR("cannot expand S3Random index to %lu buckets\n",
+          (unsigned long)(new_mask + 1));
+  }
+  memset(new_buckets, 0xff, sizeof(uint32_t) * (new_mask + 1));
+
+  // the pool is dense so we rebuild the chains slot by slot
+  for (int64_t slot = 0; slot < index->n_entry; slot++) {
+    S3Random_entry_t *entry = &index->entries[slot];
+    uint64_t b = S3Random_hash(entry->obj.obj_id) & new_mask;
+    entry->next = new_buckets[b];
+    new_buckets[b] = (uint32_t)slot;
+  }
+
+  S3Random_index_dealloc(index, index->buckets);
+  index->buckets = new_buckets;
+  index->mask = new_mask;
+}
+
+/**
+ * @brief add an entry for the request at the end of the pool, the entry
+ * is not on any queue yet
+ *
+ * @param hv S3Random_hash(req->obj_id)
+ */
+static inline S3Random_entry_t *S3Random_index_insert(S3Random_index_t *index,
+                                                      const request_t *req,
+                                                      const uint64_t hv) {
+  if (index->n_entry == index->capacity) {
+    int64_t new_capacity = index->capacity == 0 ? 1024 : index->capacity * 2;
+    if (new_capacity >= S3RANDOM_NO_SLOT) {
+      ERROR("S3Random index cannot hold more than %u objects\n",
+            S3RANDOM_NO_SLOT);
+    }
+    S3Random_entry_t *new_entries = S3Random_index_realloc(
+        index, index->entries, sizeof(S3Random_entry_t) * index->capacity,
+        sizeof(S3Random_entry_t) * new_capacity);
+    if (new_entries == NULL) {
+      ERROR("cannot grow S3Random index to %ld entries\n",
+            (long)new_capacity);
+    }
+    index->entries = new_entries;
+    if (index->track_access) {
+      int64_t *new_last_access = S3Random_index_realloc(
+          index, index->last_access, sizeof(int64_t) * index->capacity,
+          sizeof(int64_t) * new_capacity);
+      if (new_last_access == NULL) {
+        ERROR("cannot grow S3Random index to %ld entries\n",
+              (long)new_capacity);
+      }
+      index->last_access = new_last_access;
+    }
+    index->capacity = new_capacity;
+  }
+  // keep the load factor at most 1
+  if ((uint64_t)index->n_entry > index->mask) {
+    S3Random_index_expand(index);
+  }
+
+  uint32_t slot = (uint32_t)index->n_entry++;
+  S3Random_entry_t *entry = &index->entries[slot];
+  memset(entry, 0, sizeof(S3Random_entry_t));
+  entry->obj.obj_id = req->obj_id;
+  entry->obj.obj_size = req->obj_size;
+#if defined(SUPPORT_TTL) && SUPPORT_TTL == 1
+  // an object without ttl never expires
+  if (req->ttl > 0) {
+    entry->obj.exp_time = (uint32_t)(req->clock_time + req->ttl);
+    index->n_ttl += 1;
+  }
+#endif
+
+  uint64_t b = hv & index->mask;
+  entry->next = index->buckets[b];
+  index->buckets[b] = slot;
+  return entry;
+}
+
+/**
+ * @brief remove an entry that is no longer on a queue, the last entry of
+ * the pool is moved into its slot
+ */
+static inline void S3Random_index_remove(S3Random_index_t *index,
+                                         S3Random_entry_t *entry) {
+  uint32_t slot = S3Random_index_slot(index, entry);
+  uint32_t last_slot = (uint32_t)(index->n_entry - 1);
+#if defined(SUPPORT_TTL) && SUPPORT_TTL == 1
+  if (entry->obj.exp_time != 0) {
+    index->n_ttl -= 1;
+  }
+#endif
+
+  // unlink the entry from its chain
+  *S3Random_index_link(index, slot) = entry->next;
+
+  if (slot != last_slot) {
+    // the chain and the queue that point to the last entry now point to
+    // the hole, then the last entry is moved into the hole
+    *S3Random_index_link(index, last_slot) = slot;
+    S3Random_entry_t *last = &index->entries[last_slot];
+    index->queues[last->md.queue]->slots[last->pos] = slot;
+    *entry = *last;
+    if (index->last_access != NULL) {
+      index->last_access[slot] = index->last_access[last_slot];
+    }
+  }
+  index->n_entry -= 1;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                          queues                               ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief the bytes an entry takes in its queue, its size and its metadata
+ */
+static inline int64_t S3Random_entry_byte(const S3Random_index_t *index,
+                                          const S3Random_entry_t *entry) {
+  return (int64_t)entry->obj.obj_size + index->obj_md_size;
+}
+
+/**
+ * @param seed the seed of the cache, each queue derives its own stream
+ */
+static inline void S3Random_queue_init(S3Random_queue_t *queue,
+                                       S3Random_index_t *index, uint8_t id,
+                                       int64_t cache_size, uint64_t seed) {
+  memset(queue, 0, sizeof(S3Random_queue_t));
+  queue->index = index;
+  queue->id = id;
+  queue->cache_size = cache_size;
+  S3Random_rng_seed(&queue->rng, seed * S3RANDOM_N_QUEUE + id);
+  index->queues[id] = queue;
+}
+
+/**
+ * @brief free the queue, the entries are freed with the index
+ */
+static inline void S3Random_queue_free(S3Random_queue_t *queue) {
+  S3Random_index_dealloc(queue->index, queue->slots);
+  queue->slots = NULL;
+  queue->n_obj = 0;
+}
+
+static inline void S3Random_queue_push(S3Random_queue_t *queue,
+                                       S3Random_entry_t *entry) {
+  if (queue->n_obj == queue->capacity) {
+    int64_t old_capacity = queue->capacity;
+    queue->capacity = queue->capacity == 0 ? 1024 : queue->capacity * 2;
+    queue->slots = S3Random_index_realloc(queue->index, queue->slots,
+                                          sizeof(uint32_t) * old_capacity,
+                                          sizeof(uint32_t) * queue->capacity);
+    if (queue->slots == NULL) {
+      ERROR("cannot grow S3Random queue to %ld entries\n",
+            (long)queue->capacity);
+    }
+  }
+  entry->md.queue = queue->id;
+  entry->pos = (uint32_t)queue->n_obj;
+  queue->slots[queue->n_obj++] = S3Random_index_slot(queue->index, entry);
+  queue->occupied_byte += S3Random_entry_byte(queue->index, entry);
+}
+
+/**
+ * @brief remove an entry from the queue by swapping the last slot of the
+ * queue in its place, the entry stays in the index
+ */
+static inline void S3Random_queue_remove(S3Random_queue_t *queue,
+                                         S3Random_entry_t *entry) {
+  DEBUG_ASSERT(entry->md.queue == queue->id);
+  DEBUG_ASSERT(queue->slots[entry->pos] ==
+               S3Random_index_slot(queue->index, entry));
+  uint32_t last_slot = queue->slots[--queue->n_obj];
+  queue->slots[entry->pos] = last_slot;
+  queue->index->entries[last_slot].pos = entry->pos;
+  queue->occupied_byte -= S3Random_entry_byte(queue->index, entry);
+}
+
+/**
+ * @brief move an entry to another queue, this only flips the tag
+ */
+static inline void S3Random_queue_move(S3Random_queue_t *from,
+                                       S3Random_queue_t *to,
+                                       S3Random_entry_t *entry) {
+  S3Random_queue_remove(from, entry);
+  S3Random_queue_push(to, entry);
+}
+
+/**
+ * @brief promote an entry of small to main in place, it keeps its slot in
+ * the pool and its chain, nothing is allocated, hashed or copied, the
+ * caller resets the metadata main gives to a new object
+ */
+static inline void S3Random_queue_promote(S3Random_queue_t *small,
+                                          S3Random_queue_t *main,
+                                          S3Random_entry_t *entry) {
+  S3Random_queue_move(small, main, entry);
+  entry->md.moved_to_main = 1;
+}
+
+static inline S3Random_entry_t *S3Random_queue_rand(S3Random_queue_t *queue) {
+  DEBUG_ASSERT(queue->n_obj > 0);
+  uint64_t pos = S3Random_rng_bounded(&queue->rng, (uint64_t)queue->n_obj);
+  return &queue->index->entries[queue->slots[pos]];
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                            ttl                                ****
+// ****                                                               ****
+// ***********************************************************************
+
+/**
+ * @brief the object of the entry expired before clock_time, like
+ * cache_find_base of libCacheSim
+ */
+static inline bool S3Random_entry_expired_at(const S3Random_entry_t *entry,
+                                             const int64_t clock_time) {
+#if defined(SUPPORT_TTL) && SUPPORT_TTL == 1
+  return entry->obj.exp_time != 0 && (int64_t)entry->obj.exp_time < clock_time;
+#else
+  return false;
+#endif
+}
+
+static inline bool S3Random_entry_expired(const S3Random_index_t *index,
+                                          const S3Random_entry_t *entry) {
+  return S3Random_entry_expired_at(entry, index->clock_time);
+}
+
+/**
+ * @brief draw n_probe random entries of the queue and return the first one
+ * that expired, nothing is drawn when no entry has an expiration time so
+ * a cache without ttl evicts exactly as before
+ *
+ * @return NULL if none of them expired
+ */
+static inline S3Random_entry_t *S3Random_queue_rand_expired(
+    S3Random_queue_t *queue, const int n_probe) {
+  const S3Random_index_t *index = queue->index;
+  if (index->n_ttl == 0 || queue->n_obj == 0) {
+    return NULL;
+  }
+  for (int i = 0; i < n_probe; i++) {
+    S3Random_entry_t *entry = S3Random_queue_rand(queue);
+    if (S3Random_entry_expired(index, entry)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief free an expired entry, it is not remembered by the ghost since
+ * it would come back as a new object anyway
+ *
+ * @return the bytes freed
+ */
+static inline int64_t S3Random_queue_reclaim(S3Random_queue_t *queue,
+                                             S3Random_entry_t *entry) {
+  int64_t freed = S3Random_entry_byte(queue->index, entry);
+  S3Random_queue_remove(queue, entry);
+  S3Random_index_remove(queue->index, entry);
+  return freed;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_INDEX_H
@@ -0,0 +1,182 @@
+//  optional latency histograms of the operations of the S3Random family
+//
+//  compiled in with -DS3RANDOM_LATENCY, without it the macros below are
+//  empty and the caches carry no histogram
+//
+//  every operation of a cache (get, find, insert, evicting from small,
+//  evicting from main) records its duration in a log-linear histogram like
+//  HdrHistogram: values below 2^S3RANDOM_LAT_SUB_BITS get their own bucket,
+//  above that each power of two is split in 2^S3RANDOM_LAT_SUB_BITS
+//  buckets, so a percentile is off by at most 1/32 of its value
+//  the cache prints p50/p99/p99.9/max of each operation when it is freed
+//
+//  the durations are in ns from clock_gettime, or in cycles from the TSC
+//  with -DS3RANDOM_LATENCY_TSC on x86
+//
+//
+//  S3RandomLatency.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_LATENCY_H
+#define S3RANDOM_LATENCY_H
+
+#ifdef S3RANDOM_LATENCY
+
+#include <stdio.h>
+#include <time.h>
+#if defined(S3RANDOM_LATENCY_TSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define S3RANDOM_LAT_SUB_BITS 5
+#define S3RANDOM_LAT_SUB (1 << S3RANDOM_LAT_SUB_BITS)
+#define S3RANDOM_LAT_N_BUCKET ((64 - S3RANDOM_LAT_SUB_BITS + 1) * S3RANDOM_LAT_SUB)
+
+typedef enum {
+  S3RANDOM_LAT_GET = 0,
+  S3RANDOM_LAT_FIND = 1,
+  S3RANDOM_LAT_INSERT = 2,
+  S3RANDOM_LAT_EVICT_SMALL = 3,
+  S3RANDOM_LAT_EVICT_MAIN = 4,
+  S3RANDOM_LAT_N_OP = 5,
+} S3Random_lat_op_e;
+
+typedef struct {
+  int64_t count[S3RANDOM_LAT_N_BUCKET];
+  int64_t n;
+  uint64_t sum;
+  uint64_t max;
+} S3Random_lat_hist_t;
+
+typedef struct {
+  S3Random_lat_hist_t op[S3RANDOM_LAT_N_OP];
+} S3Random_latency_t;
+
+#if defined(S3RANDOM_LATENCY_TSC) && (defined(__x86_64__) || defined(__i386__))
+#define S3RANDOM_LAT_UNIT "cycles"
+static inline uint64_t S3Random_lat_now(void) { return __rdtsc(); }
+#else
+#define S3RANDOM_LAT_UNIT "ns"
+static inline uint64_t S3Random_lat_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+static inline const char *S3Random_lat_op_name(const S3Random_lat_op_e op) {
+  switch (op) {
+    case S3RANDOM_LAT_GET:
+      return "get";
+    case S3RANDOM_LAT_FIND:
+      return "find";
+    case S3RANDOM_LAT_INSERT:
+      return "insert";
+    case S3RANDOM_LAT_EVICT_SMALL:
+      return "evict_small";
+    case S3RANDOM_LAT_EVICT_MAIN:
+      return "evict_main";
+    default:
+      return "unknown";
+  }
+}
+
+static inline int S3Random_lat_bucket(const uint64_t v) {
+  if (v < S3RANDOM_LAT_SUB) {
+    return (int)v;
+  }
+  int shift = 63 - __builtin_clzll(v) - S3RANDOM_LAT_SUB_BITS;
+  return (shift + 1) * S3RANDOM_LAT_SUB +
+         (int)((v >> shift) & (S3RANDOM_LAT_SUB - 1));
+}
+
+/**
+ * @brief the largest value that falls in bucket b
+ */
+static inline uint64_t S3Random_lat_bucket_value(const int b) {
+  if (b < S3RANDOM_LAT_SUB) {
+    return (uint64_t)b;
+  }
+  int shift = b / S3RANDOM_LAT_SUB - 1;
+  uint64_t m = S3RANDOM_LAT_SUB + (uint64_t)(b % S3RANDOM_LAT_SUB);
+  return ((m + 1) << shift) - 1;
+}
+
+static inline void S3Random_lat_record(S3Random_latency_t *latency,
+                                       const S3Random_lat_op_e op,
+                                       const uint64_t start) {
+  uint64_t v = S3Random_lat_now() - start;
+  S3Random_lat_hist_t *hist = &latency->op[op];
+  hist->count[S3Random_lat_bucket(v)] += 1;
+  hist->n += 1;
+  hist->sum += v;
+  hist->max = MAX(hist->max, v);
+}
+
+/**
+ * @brief the value below which a fraction p of the samples fall
+ */
+static inline uint64_t S3Random_lat_percentile(const S3Random_lat_hist_t *hist,
+                                               const double p) {
+  int64_t rank = (int64_t)(p * (double)hist->n);
+  int64_t seen = 0;
+  for (int b = 0; b < S3RANDOM_LAT_N_BUCKET; b++) {
+    seen += hist->count[b];
+    if (seen > rank) {
+      return MIN(S3Random_lat_bucket_value(b), hist->max);
+    }
+  }
+  return hist->max;
+}
+
+static inline void S3Random_latency_print(const S3Random_latency_t *latency,
+                                          const char *cache_name, FILE *out) {
+  fprintf(out, "%s latency (%s)\n", cache_name, S3RANDOM_LAT_UNIT);
+  fprintf(out, "%-12s %12s %10s %10s %10s %10s %10s\n", "op", "n", "mean",
+          "p50", "p99", "p99.9", "max");
+  for (int op = 0; op < S3RANDOM_LAT_N_OP; op++) {
+    const S3Random_lat_hist_t *hist = &latency->op[op];
+    if (hist->n == 0) {
+      continue;
+    }
+    fprintf(out, "%-12s %12lld %10.1f %10llu %10llu %10llu %10llu\n",
+            S3Random_lat_op_name((S3Random_lat_op_e)op), (long long)hist->n,
+            (double)hist->sum / (double)hist->n,
+            (unsigned long long)S3Random_lat_percentile(hist, 0.5),
+            (unsigned long long)S3Random_lat_percentile(hist, 0.99),
+            (unsigned long long)S3Random_lat_percentile(hist, 0.999),
+            (unsigned long long)hist->max);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+// declare a start time, record the time since it in a histogram
+#define S3RANDOM_LAT_START(start) uint64_t start = S3Random_lat_now()
+#define S3RANDOM_LAT_RECORD(latency, op, start) \
+  S3Random_lat_record((latency), (op), (start))
+#define S3RANDOM_LAT_PRINT(latency, cache_name) \
+  S3Random_latency_print((latency), (cache_name), stderr)
+// forget the durations recorded so far, at the end of the warmup
+#define S3RANDOM_LAT_RESET(latency) \
+  memset((latency), 0, sizeof(S3Random_latency_t))
+
+#else
+
+#define S3RANDOM_LAT_START(start)
+#define S3RANDOM_LAT_RECORD(latency, op, start)
+#define S3RANDOM_LAT_PRINT(latency, cache_name)
+#define S3RANDOM_LAT_RESET(latency)
+
+#endif  // S3RANDOM_LATENCY
+
+#endif  // S3RANDOM_LATENCY_H
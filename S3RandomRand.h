@@ -0,0 +1,93 @@
+//  per-instance random number generator of the S3Random family
+//
+//  every queue owns a xoshiro256** generator seeded from the seed parameter
+//  of the cache, so there is no global random state shared by caches or
+//  threads and a run with the same seed evicts the same objects on any
+//  machine
+//
+//  a random position in a queue of n objects is the high 64 bits of
+//  r * n (Lemire), which avoids the division of r % n
+//
+//
+//  S3RandomRand.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_RAND_H
+#define S3RANDOM_RAND_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the seed of a cache that is not given one
+#define S3RANDOM_DEFAULT_SEED 0x5eed5eedULL
+
+typedef struct {
+  uint64_t s[4];
+} S3Random_rng_t;
+
+static inline uint64_t S3Random_splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief seed the generator, the state is expanded with splitmix64 so that
+ * close seeds give unrelated streams and the state is never all zero
+ */
+static inline void S3Random_rng_seed(S3Random_rng_t *rng, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    rng->s[i] = S3Random_splitmix64(&seed);
+  }
+}
+
+static inline uint64_t S3Random_rng_rotl(const uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256**
+static inline uint64_t S3Random_rng_next(S3Random_rng_t *rng) {
+  uint64_t *s = rng->s;
+  const uint64_t result = S3Random_rng_rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = S3Random_rng_rotl(s[3], 45);
+  return result;
+}
+
+/**
+ * @brief a random number in [0, n)
+ */
+static inline uint64_t S3Random_rng_bounded(S3Random_rng_t *rng,
+                                            const uint64_t n) {
+  return (uint64_t)(((__uint128_t)S3Random_rng_next(rng) * n) >> 64);
+}
+
+/**
+ * @brief k random numbers in [0, n), the generator state stays in
+ * registers for the whole batch
+ */
+static inline void S3Random_rng_bounded_batch(S3Random_rng_t *rng,
+                                              const uint64_t n, uint32_t *out,
+                                              const int k) {
+  S3Random_rng_t local = *rng;
+  for (int i = 0; i < k; i++) {
+    out[i] = (uint32_t)S3Random_rng_bounded(&local, n);
+  }
+  *rng = local;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_RAND_H
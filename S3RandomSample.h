@@ -0,0 +1,281 @@
+//  K-way sampled victim selection for the queues of S3Random
+//
+//  RandomK draws K random entries of a queue and evicts the one with the
+//  lowest score, K = 1 is Random and K = 2 with the last access time is
+//  RandomTwo, a larger K gets closer to LRU/LFU at the cost of more random
+//  memory reads
+//
+//  the scores of the sampled entries are gathered into a structure of
+//  arrays so that the lowest one is found with an AVX2/SSE4.2 kernel, the
+//  kernel is chosen at run time from the CPU so the default build uses it,
+//  with a scalar fallback when neither is available
+//
+//  the score is pluggable
+//      last access:  older is evicted first
+//      frequency:    the 2-bit counter of the entry, lower is evicted first
+//      size:         larger is evicted first
+//      none:         every entry ties and the first candidate is evicted,
+//                    so RandomK is Random
+//  when a number of bytes has to be freed the choice can be size-aware,
+//  the lowest score among the candidates large enough to free the bytes
+//  alone, so a large insert evicts a few large objects instead of many
+//  small ones
+//
+//
+//  S3RandomSample.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_SAMPLE_H
+#define S3RANDOM_SAMPLE_H
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "S3RandomIndex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the most candidates sampled at once
+#define S3RANDOM_MAX_SAMPLE 32
+
+typedef enum {
+  S3RANDOM_SCORE_LAST_ACCESS = 0,
+  S3RANDOM_SCORE_FREQ = 1,
+  S3RANDOM_SCORE_SIZE = 2,
+  S3RANDOM_SCORE_NONE = 3,
+} S3Random_score_e;
+
+typedef struct {
+  // the lowest score is evicted first
+  int64_t score[S3RANDOM_MAX_SAMPLE] __attribute__((aligned(32)));
+  uint32_t slot[S3RANDOM_MAX_SAMPLE];
+  int n;
+} S3Random_sample_t;
+
+static inline const char *S3Random_score_name(const S3Random_score_e score) {
+  switch (score) {
+    case S3RANDOM_SCORE_LAST_ACCESS:
+      return "last-access";
+    case S3RANDOM_SCORE_FREQ:
+      return "freq";
+    case S3RANDOM_SCORE_SIZE:
+      return "size";
+    case S3RANDOM_SCORE_NONE:
+      return "none";
+    default:
+      return "unknown";
+  }
+}
+
+/**
+ * @brief parse the name of a score
+ *
+ * @return the score or -1 if the name is unknown
+ */
+static inline int S3Random_score_parse(const char *name) {
+  if (strcasecmp(name, "last-access") == 0) {
+    return S3RANDOM_SCORE_LAST_ACCESS;
+  } else if (strcasecmp(name, "freq") == 0) {
+    return S3RANDOM_SCORE_FREQ;
+  } else if (strcasecmp(name, "size") == 0) {
+    return S3RANDOM_SCORE_SIZE;
+  } else if (strcasecmp(name, "none") == 0) {
+    return S3RANDOM_SCORE_NONE;
+  }
+  return -1;
+}
+
+/**
+ * @brief the score of an entry, last-access needs an index that tracks the
+ * access time
+ */
+static inline int64_t S3Random_entry_score(const S3Random_index_t *index,
+                                           const S3Random_entry_t *entry,
+                                           const S3Random_score_e score) {
+  switch (score) {
+    case S3RANDOM_SCORE_FREQ:
+      return entry->md.freq;
+    case S3RANDOM_SCORE_SIZE:
+      return -(int64_t)entry->obj.obj_size;
+    case S3RANDOM_SCORE_NONE:
+      return 0;
+    case S3RANDOM_SCORE_LAST_ACCESS:
+    default:
+      return *S3Random_index_last_access(index, entry);
+  }
+}
+
+// the SIMD kernels are built with the target attribute so that they do not
+// need -mavx2 or -msse4.2, the one to use is chosen at run time from the
+// CPU, a build with -mavx2 calls the AVX2 kernel directly
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define S3RANDOM_SIMD 1
+#else
+#define S3RANDOM_SIMD 0
+#endif
+
+/**
+ * @brief the scalar argmin of score[i..n), best is the lowest one before i
+ */
+static inline int S3Random_argmin_tail(const int64_t *score, const int n,
+                                       int best, int i) {
+  for (; i < n; i++) {
+    if (score[i] < score[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+#if S3RANDOM_SIMD
+/**
+ * @brief the argmin with 4 lanes of 64 bits, n >= 8
+ */
+__attribute__((target("avx2"))) static inline int S3Random_argmin_avx2(
+    const int64_t *score, const int n) {
+  __m256i min_v = _mm256_loadu_si256((const __m256i *)score);
+  __m256i idx_v = _mm256_setr_epi64x(0, 1, 2, 3);
+  __m256i min_idx = idx_v;
+  const __m256i step = _mm256_set1_epi64x(4);
+  int i;
+  for (i = 4; i + 4 <= n; i += 4) {
+    idx_v = _mm256_add_epi64(idx_v, step);
+    __m256i v = _mm256_loadu_si256((const __m256i *)(score + i));
+    __m256i lt = _mm256_cmpgt_epi64(min_v, v);
+    min_v = _mm256_blendv_epi8(min_v, v, lt);
+    min_idx = _mm256_blendv_epi8(min_idx, idx_v, lt);
+  }
+  int64_t lane_min[4], lane_idx[4];
+  _mm256_storeu_si256((__m256i *)lane_min, min_v);
+  _mm256_storeu_si256((__m256i *)lane_idx, min_idx);
+  int lane = 0;
+  for (int l = 1; l < 4; l++) {
+    if (lane_min[l] < lane_min[lane] ||
+        (lane_min[l] == lane_min[lane] && lane_idx[l] < lane_idx[lane])) {
+      lane = l;
+    }
+  }
+  return S3Random_argmin_tail(score, n, (int)lane_idx[lane], i);
+}
+
+/**
+ * @brief the argmin with 2 lanes of 64 bits, n >= 4
+ */
+__attribute__((target("sse4.2"))) static inline int S3Random_argmin_sse42(
+    const int64_t *score, const int n) {
+  __m128i min_v = _mm_loadu_si128((const __m128i *)score);
+  __m128i idx_v = _mm_set_epi64x(1, 0);
+  __m128i min_idx = idx_v;
+  const __m128i step = _mm_set1_epi64x(2);
+  int i;
+  for (i = 2; i + 2 <= n; i += 2) {
+    idx_v = _mm_add_epi64(idx_v, step);
+    __m128i v = _mm_loadu_si128((const __m128i *)(score + i));
+    __m128i lt = _mm_cmpgt_epi64(min_v, v);
+    min_v = _mm_blendv_epi8(min_v, v, lt);
+    min_idx = _mm_blendv_epi8(min_idx, idx_v, lt);
+  }
+  int64_t lane_min[2], lane_idx[2];
+  _mm_storeu_si128((__m128i *)lane_min, min_v);
+  _mm_storeu_si128((__m128i *)lane_idx, min_idx);
+  int lane = lane_min[1] < lane_min[0] ||
+                     (lane_min[1] == lane_min[0] && lane_idx[1] < lane_idx[0])
+                 ? 1
+                 : 0;
+  return S3Random_argmin_tail(score, n, (int)lane_idx[lane], i);
+}
+#endif
+
+/**
+ * @brief the position of the lowest score, the first one on ties
+ *
+ * __builtin_cpu_supports reads the features libgcc found at start up, it
+ * is a load and a test on every call
+ */
+static inline int S3Random_argmin(const int64_t *score, const int n) {
+#if S3RANDOM_SIMD && defined(__AVX2__)
+  if (n >= 8) {
+    return S3Random_argmin_avx2(score, n);
+  }
+#elif S3RANDOM_SIMD
+  if (n >= 8 && __builtin_cpu_supports("avx2")) {
+    return S3Random_argmin_avx2(score, n);
+  }
+  if (n >= 4 && __builtin_cpu_supports("sse4.2")) {
+    return S3Random_argmin_sse42(score, n);
+  }
+#endif
+  // a short sample, or no SIMD
+  return S3Random_argmin_tail(score, n, 0, 1);
+}
+
+/**
+ * @brief draw k random entries of the queue, an entry drawn twice is kept
+ * once, and gather their scores
+ */
+static inline void S3Random_queue_sample(S3Random_queue_t *queue,
+                                         const int k,
+                                         const S3Random_score_e score,
+                                         S3Random_sample_t *sample) {
+  DEBUG_ASSERT(queue->n_obj > 0);
+  DEBUG_ASSERT(k > 0 && k <= S3RANDOM_MAX_SAMPLE);
+  uint32_t pos[S3RANDOM_MAX_SAMPLE];
+  S3Random_rng_bounded_batch(&queue->rng, (uint64_t)queue->n_obj, pos, k);
+  sample->n = 0;
+  for (int i = 0; i < k; i++) {
+    uint32_t slot = queue->slots[pos[i]];
+    bool sampled = false;
+    for (int j = 0; j < sample->n; j++) {
+      sampled = sampled || sample->slot[j] == slot;
+    }
+    if (sampled) {
+      continue;
+    }
+    sample->slot[sample->n] = slot;
+    sample->score[sample->n] =
+        S3Random_entry_score(queue->index, &queue->index->entries[slot], score);
+    sample->n += 1;
+  }
+}
+
+static inline S3Random_entry_t *S3Random_sample_entry(
+    const S3Random_queue_t *queue, const S3Random_sample_t *sample,
+    const int i) {
+  return &queue->index->entries[sample->slot[i]];
+}
+
+/**
+ * @brief the position in the sample of the entry to evict
+ */
+static inline int S3Random_sample_best(const S3Random_sample_t *sample) {
+  return S3Random_argmin(sample->score, sample->n);
+}
+
+/**
+ * @brief the position in the sample of the entry to evict to free need_byte
+ * bytes, the lowest score among the entries that free them alone, or among
+ * all the entries when none does
+ */
+static inline int S3Random_sample_best_fit(const S3Random_queue_t *queue,
+                                           const S3Random_sample_t *sample,
+                                           const int64_t need_byte) {
+  int best = -1;
+  for (int i = 0; i < sample->n; i++) {
+    const S3Random_entry_t *entry = S3Random_sample_entry(queue, sample, i);
+    if (S3Random_entry_byte(queue->index, entry) >= need_byte &&
+        (best == -1 || sample->score[i] < sample->score[best])) {
+      best = i;
+    }
+  }
+  return best == -1 ? S3Random_sample_best(sample) : best;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_SAMPLE_H
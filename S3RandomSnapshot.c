@@ -0,0 +1,618 @@
+//  snapshot and warm restart of the S3Random family
+//  see S3RandomSnapshot.h
+//
+//
+//  S3RandomSnapshot.c
+//  libCacheSim
+//
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "S3RandomSnapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void S3Random_get_state(cache_t *cache, S3Random_state_t *state);
+void S3Randomtwo_get_state(cache_t *cache, S3Random_state_t *state);
+void S3Randomfreq_get_state(cache_t *cache, S3Random_state_t *state);
+int S3Randomsharded_get_shards(const cache_t *cache, cache_t **shards,
+                               int64_t **n_lock_free_hit);
+void S3Randomsharded_lock_all(cache_t *cache, const bool lock);
+
+#define S3RANDOM_SNAPSHOT_ALIGN(n) (((int64_t)(n) + 63) & ~(int64_t)63)
+// records converted at once when a section is written
+#define S3RANDOM_SNAPSHOT_WRITE_BATCH 4096
+
+// a part of the records rebuilt by one thread
+typedef struct {
+  S3Random_index_t *index;
+  const S3Random_snapshot_record_t *records;
+  int64_t begin;
+  int64_t end;
+  int64_t occupied_byte[S3RANDOM_N_QUEUE];
+  int64_t n_ttl;
+  bool corrupted;
+} S3Random_snapshot_loader_t;
+
+/**
+ * @return false if the cache is not a S3Random, S3Randomtwo or S3Randomfreq
+ */
+static bool S3Random_snapshot_state(cache_t *cache, S3Random_state_t *state) {
+  memset(state, 0, sizeof(S3Random_state_t));
+  if (strcasecmp(cache->cache_name, "S3Random") == 0) {
+    S3Random_get_state(cache, state);
+  } else if (strcasecmp(cache->cache_name, "S3Randomtwo") == 0) {
+    S3Randomtwo_get_state(cache, state);
+  } else if (strcasecmp(cache->cache_name, "S3Randomfreq") == 0) {
+    S3Randomfreq_get_state(cache, state);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static inline bool S3Random_snapshot_is_sharded(const cache_t *cache) {
+  return strcasecmp(cache->cache_name, "S3Randomsharded") == 0;
+}
+
+/**
+ * @brief the caches written in the sections, the shards of
+ * S3Randomsharded or the cache itself
+ *
+ * @param n_lock_free_hit the lock-free hit counters of the shards, NULL
+ * for a cache that is not sharded
+ * @return the number of caches, 0 if the cache is not of the family
+ */
+static int S3Random_snapshot_caches(cache_t *cache, cache_t **caches,
+                                    int64_t **n_lock_free_hit) {
+  if (S3Random_snapshot_is_sharded(cache)) {
+    return S3Randomsharded_get_shards(cache, caches, n_lock_free_hit);
+  }
+  S3Random_state_t state;
+  if (!S3Random_snapshot_state(cache, &state)) {
+    return 0;
+  }
+  caches[0] = cache;
+  n_lock_free_hit[0] = NULL;
+  return 1;
+}
+
+/**
+ * @brief the bytes of a section after its header
+ */
+static int64_t S3Random_snapshot_section_n_byte(
+    const S3Random_snapshot_section_t *section) {
+  return S3RANDOM_SNAPSHOT_ALIGN(section->n_entry *
+                                 sizeof(S3Random_snapshot_record_t)) +
+         S3RANDOM_SNAPSHOT_ALIGN(section->ghost.n_bucket *
+                                 sizeof(S3Random_ghost_bucket_t)) +
+         S3RANDOM_SNAPSHOT_ALIGN(S3Random_ghost_filter_memory(&section->ghost));
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                             save                              ****
+// ****                                                               ****
+// ***********************************************************************
+
+static bool S3Random_snapshot_write_pad(FILE *file, const int64_t n_byte) {
+  static const char zero[64] = {0};
+  size_t pad = (size_t)(S3RANDOM_SNAPSHOT_ALIGN(n_byte) - n_byte);
+  return pad == 0 || fwrite(zero, 1, pad, file) == pad;
+}
+
+static bool S3Random_snapshot_write_section(FILE *file, cache_t *cache,
+                                            const int64_t *n_lock_free_hit) {
+  S3Random_state_t state;
+  S3Random_snapshot_state(cache, &state);
+  S3Random_index_t *index = state.index;
+
+  S3Random_snapshot_section_t section;
+  memset(&section, 0, sizeof(section));
+  snprintf(section.cache_name, sizeof(section.cache_name), "%s",
+           cache->cache_name);
+  section.cache_size = cache->cache_size;
+  section.obj_md_size = index->obj_md_size;
+  section.ghost_init = S3Random_ghost_is_init(state.ghost);
+  section.n_req = cache->n_req;
+  section.clock_time = index->clock_time;
+  section.vtime = index->vtime;
+  section.n_entry = index->n_entry;
+  for (int q = 0; q < S3RANDOM_N_QUEUE; q++) {
+    section.n_obj[q] = index->queues[q]->n_obj;
+    section.queue_cache_size[q] = index->queues[q]->cache_size;
+    section.rng[q] = index->queues[q]->rng;
+    if (n_lock_free_hit != NULL) {
+      section.n_lock_free_hit[q] =
+          __atomic_load_n(&n_lock_free_hit[q], __ATOMIC_RELAXED);
+    }
+  }
+  section.adapt = *state.adapt;
+  section.stats = *state.stats;
+  section.ghost = *state.ghost;
+  section.n_byte = S3Random_snapshot_section_n_byte(&section);
+  if (fwrite(&section, sizeof(section), 1, file) != 1) {
+    return false;
+  }
+
+  //the records are in the order of the pool, so the slots of the queues
+  //and the chains stay valid when they are loaded
+  S3Random_snapshot_record_t records[S3RANDOM_SNAPSHOT_WRITE_BATCH];
+  for (int64_t done = 0; done < index->n_entry;
+       done += S3RANDOM_SNAPSHOT_WRITE_BATCH) {
+    int n = (int)MIN(index->n_entry - done, S3RANDOM_SNAPSHOT_WRITE_BATCH);
+    memset(records, 0, sizeof(S3Random_snapshot_record_t) * n);
+    for (int i = 0; i < n; i++) {
+      const S3Random_entry_t *entry = &index->entries[done + i];
+      records[i].obj_id = entry->obj.obj_id;
+      if (index->last_access != NULL) {
+        records[i].last_access_vtime = index->last_access[done + i];
+      }
+      records[i].obj_size = entry->obj.obj_size;
+      records[i].pos = entry->pos;
+      records[i].md = entry->md.byte;
+#if defined(SUPPORT_TTL) && SUPPORT_TTL == 1
+      records[i].exp_time = entry->obj.exp_time;
+#endif
+    }
+    if (fwrite(records, sizeof(S3Random_snapshot_record_t), n, file) !=
+        (size_t)n) {
+      return false;
+    }
+  }
+  if (!S3Random_snapshot_write_pad(
+          file, index->n_entry * sizeof(S3Random_snapshot_record_t))) {
+    return false;
+  }
+
+  const S3Random_ghost_t *ghost = state.ghost;
+  if (section.ghost_init &&
+      fwrite(ghost->buckets, sizeof(S3Random_ghost_bucket_t), ghost->n_bucket,
+             file) != ghost->n_bucket) {
+    return false;
+  }
+  size_t filter_byte = (size_t)S3Random_ghost_filter_memory(ghost);
+  if (filter_byte > 0 && fwrite(ghost->filter, 1, filter_byte, file) != filter_byte) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @param lock take the locks of the shards, the child of save_background
+ * inherited them taken
+ */
+static bool S3Random_snapshot_write(cache_t *cache, const char *path,
+                                    const bool lock) {
+  cache_t **caches = malloc(sizeof(cache_t *) * S3RANDOM_SNAPSHOT_MAX_SECTION);
+  int64_t **n_lock_free_hit =
+      malloc(sizeof(int64_t *) * S3RANDOM_SNAPSHOT_MAX_SECTION);
+  int n_section = S3Random_snapshot_caches(cache, caches, n_lock_free_hit);
+  if (n_section == 0) {
+    WARN("%s is not a S3Random cache, it has no snapshot\n",
+         cache->cache_name);
+    free(n_lock_free_hit);
+    free(caches);
+    return false;
+  }
+
+  size_t path_len = strlen(path) + 5;
+  char *tmp_path = malloc(path_len);
+  snprintf(tmp_path, path_len, "%s.tmp", path);
+  FILE *file = fopen(tmp_path, "wb");
+  if (file == NULL) {
+    WARN("S3Random snapshot cannot write %s\n", tmp_path);
+    free(tmp_path);
+    free(n_lock_free_hit);
+    free(caches);
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+  S3Random_snapshot_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, S3RANDOM_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = S3RANDOM_SNAPSHOT_VERSION;
+  header.header_byte = sizeof(S3Random_snapshot_header_t);
+  header.section_byte = sizeof(S3Random_snapshot_section_t);
+  header.record_byte = sizeof(S3Random_snapshot_record_t);
+  header.n_section = n_section;
+  snprintf(header.cache_name, sizeof(header.cache_name), "%s",
+           cache->cache_name);
+  header.cache_size = cache->cache_size;
+  header.n_req = cache->n_req;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  bool sharded = S3Random_snapshot_is_sharded(cache);
+  if (lock && sharded) {
+    S3Randomsharded_lock_all(cache, true);
+  }
+  for (int i = 0; ok && i < n_section; i++) {
+    ok = S3Random_snapshot_write_section(file, caches[i], n_lock_free_hit[i]);
+  }
+  if (lock && sharded) {
+    S3Randomsharded_lock_all(cache, false);
+  }
+
+  //the snapshot replaces the old one only once it is on the disk
+  ok = fflush(file) == 0 && ok;
+  ok = fsync(fileno(file)) == 0 && ok;
+  ok = fclose(file) == 0 && ok;
+  if (ok) {
+    ok = rename(tmp_path, path) == 0;
+  } else {
+    WARN("S3Random snapshot cannot write %s\n", tmp_path);
+    unlink(tmp_path);
+  }
+  free(tmp_path);
+  free(n_lock_free_hit);
+  free(caches);
+  return ok;
+}
+
+bool S3Random_snapshot_save(cache_t *cache, const char *path) {
+  return S3Random_snapshot_write(cache, path, true);
+}
+
+pid_t S3Random_snapshot_save_background(cache_t *cache, const char *path) {
+  //the shards are locked so that the child sees each of them between two
+  //requests
+  bool sharded = S3Random_snapshot_is_sharded(cache);
+  if (sharded) {
+    S3Randomsharded_lock_all(cache, true);
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    //the child has its own copy-on-write copy of the cache
+    bool ok = S3Random_snapshot_write(cache, path, false);
+    _exit(ok ? 0 : 1);
+  }
+  if (sharded) {
+    S3Randomsharded_lock_all(cache, false);
+  }
+  if (pid < 0) {
+    WARN("S3Random snapshot cannot fork to write %s\n", path);
+  }
+  return pid;
+}
+
+bool S3Random_snapshot_wait(pid_t pid) {
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+    return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                             load                              ****
+// ****                                                               ****
+// ***********************************************************************
+
+static void S3Random_snapshot_corrupted(const char *path) {
+  ERROR("S3Random snapshot %s is corrupted\n", path);
+  exit(1);
+}
+
+/**
+ * @brief check that a section can be loaded into a cache, nothing is
+ * changed yet
+ */
+static bool S3Random_snapshot_fits(cache_t *cache,
+                                   const S3Random_snapshot_section_t *section,
+                                   const char *path) {
+  S3Random_state_t state;
+  S3Random_snapshot_state(cache, &state);
+  if (strcasecmp(section->cache_name, cache->cache_name) != 0 ||
+      section->cache_size != cache->cache_size ||
+      section->obj_md_size != state.index->obj_md_size) {
+    WARN("S3Random snapshot %s is of a %s of %ld bytes, not a %s of %ld "
+         "bytes\n",
+         path, section->cache_name, (long)section->cache_size,
+         cache->cache_name, (long)cache->cache_size);
+    return false;
+  }
+  if (state.index->n_entry != 0 || S3Random_ghost_is_init(state.ghost)) {
+    WARN("S3Random snapshot %s is loaded into a cache that is not empty\n",
+         path);
+    return false;
+  }
+  return true;
+}
+
+static void *S3Random_snapshot_load_range(void *arg) {
+  S3Random_snapshot_loader_t *loader = (S3Random_snapshot_loader_t *)arg;
+  S3Random_index_t *index = loader->index;
+
+  for (int64_t slot = loader->begin; slot < loader->end; slot++) {
+    const S3Random_snapshot_record_t *record = &loader->records[slot];
+    S3Random_md_t md;
+    md.byte = record->md;
+    S3Random_queue_t *queue = index->queues[md.queue];
+    if ((int64_t)record->pos >= queue->n_obj) {
+      loader->corrupted = true;
+      break;
+    }
+    S3Random_entry_t *entry = &index->entries[slot];
+    memset(entry, 0, sizeof(S3Random_entry_t));
+    entry->obj.obj_id = record->obj_id;
+    entry->obj.obj_size = record->obj_size;
+    entry->pos = record->pos;
+    entry->md = md;
+    if (index->last_access != NULL) {
+      index->last_access[slot] = record->last_access_vtime;
+    }
+#if defined(SUPPORT_TTL) && SUPPORT_TTL == 1
+    entry->obj.exp_time = record->exp_time;
+    loader->n_ttl += record->exp_time != 0;
+#endif
+    queue->slots[record->pos] = (uint32_t)slot;
+
+    //the threads push on the same chains, the order in a chain does not
+    //matter
+    uint64_t b = S3Random_hash(record->obj_id) & index->mask;
+    entry->next =
+        __atomic_exchange_n(&index->buckets[b], (uint32_t)slot, __ATOMIC_RELAXED);
+    loader->occupied_byte[md.queue] += S3Random_entry_byte(index, entry);
+  }
+  return NULL;
+}
+
+/**
+ * @brief give the arrays of the index and the queues their final size,
+ * the buckets and the slots are empty
+ */
+static void S3Random_snapshot_reserve(S3Random_index_t *index,
+                                      const S3Random_snapshot_section_t *section) {
+  int64_t capacity = 1024;
+  while (capacity < section->n_entry) {
+    capacity *= 2;
+  }
+  S3Random_entry_t *entries =
+      S3Random_index_alloc(index, sizeof(S3Random_entry_t) * capacity);
+  int64_t *last_access = NULL;
+  if (index->track_access) {
+    last_access = S3Random_index_alloc(index, sizeof(int64_t) * capacity);
+    if (last_access == NULL) {
+      ERROR("cannot allocate S3Random index of %ld entries\n",
+            (long)section->n_entry);
+    }
+  }
+  uint64_t mask = index->mask;
+  while ((int64_t)mask < section->n_entry) {
+    mask = mask * 2 + 1;
+  }
+  uint32_t *buckets = S3Random_index_alloc(index, sizeof(uint32_t) * (mask + 1));
+  if (entries == NULL || buckets == NULL) {
+    ERROR("cannot allocate S3Random index of %ld entries\n",
+          (long)section->n_entry);
+  }
+  memset(buckets, 0xff, sizeof(uint32_t) * (mask + 1));
+  S3Random_index_dealloc(index, index->entries);
+  S3Random_index_dealloc(index, index->last_access);
+  S3Random_index_dealloc(index, index->buckets);
+  index->entries = entries;
+  index->last_access = last_access;
+  index->capacity = capacity;
+  index->buckets = buckets;
+  index->mask = mask;
+
+  for (int q = 0; q < S3RANDOM_N_QUEUE; q++) {
+    S3Random_queue_t *queue = index->queues[q];
+    int64_t queue_capacity = 1024;
+    while (queue_capacity < section->n_obj[q]) {
+      queue_capacity *= 2;
+    }
+    S3Random_index_dealloc(index, queue->slots);
+    queue->slots = S3Random_index_alloc(index, sizeof(uint32_t) * queue_capacity);
+    if (queue->slots == NULL) {
+      ERROR("cannot grow S3Random queue to %ld entries\n",
+            (long)queue_capacity);
+    }
+    //an empty slot left after the load means the records are corrupted
+    memset(queue->slots, 0xff, sizeof(uint32_t) * queue_capacity);
+    queue->capacity = queue_capacity;
+    queue->n_obj = section->n_obj[q];
+    queue->occupied_byte = 0;
+    queue->cache_size = section->queue_cache_size[q];
+    queue->rng = section->rng[q];
+  }
+}
+
+static void S3Random_snapshot_load_section(
+    cache_t *cache, const S3Random_snapshot_section_t *section,
+    int64_t *n_lock_free_hit, int n_thread, const char *path) {
+  S3Random_state_t state;
+  S3Random_snapshot_state(cache, &state);
+  S3Random_index_t *index = state.index;
+  const uint8_t *data = (const uint8_t *)(section + 1);
+
+  S3Random_snapshot_reserve(index, section);
+  index->n_entry = section->n_entry;
+  index->n_ttl = 0;
+  index->clock_time = section->clock_time;
+  index->vtime = section->vtime;
+
+  //each thread rebuilds at least S3RANDOM_SNAPSHOT_THREAD_MIN entries
+  n_thread = (int)MIN(n_thread, section->n_entry / S3RANDOM_SNAPSHOT_THREAD_MIN);
+  n_thread = MAX(n_thread, 1);
+  S3Random_snapshot_loader_t loaders[S3RANDOM_SNAPSHOT_MAX_THREAD];
+  pthread_t threads[S3RANDOM_SNAPSHOT_MAX_THREAD];
+  for (int i = 0; i < n_thread; i++) {
+    S3Random_snapshot_loader_t *loader = &loaders[i];
+    memset(loader, 0, sizeof(S3Random_snapshot_loader_t));
+    loader->index = index;
+    loader->records = (const S3Random_snapshot_record_t *)data;
+    loader->begin = section->n_entry * i / n_thread;
+    loader->end = section->n_entry * (i + 1) / n_thread;
+    if (i > 0) {
+      pthread_create(&threads[i], NULL, S3Random_snapshot_load_range, loader);
+    }
+  }
+  S3Random_snapshot_load_range(&loaders[0]);
+  bool corrupted = loaders[0].corrupted;
+  for (int i = 1; i < n_thread; i++) {
+    pthread_join(threads[i], NULL);
+    corrupted = corrupted || loaders[i].corrupted;
+  }
+  for (int i = 0; i < n_thread; i++) {
+    for (int q = 0; q < S3RANDOM_N_QUEUE; q++) {
+      index->queues[q]->occupied_byte += loaders[i].occupied_byte[q];
+    }
+    index->n_ttl += loaders[i].n_ttl;
+  }
+  //the counts match and every position is in range, so the positions are
+  //a permutation if no slot is left empty
+  for (int q = 0; q < S3RANDOM_N_QUEUE && !corrupted; q++) {
+    S3Random_queue_t *queue = index->queues[q];
+    for (int64_t pos = 0; pos < queue->n_obj; pos++) {
+      if (queue->slots[pos] == S3RANDOM_NO_SLOT) {
+        corrupted = true;
+        break;
+      }
+    }
+  }
+  if (corrupted) {
+    S3Random_snapshot_corrupted(path);
+  }
+  data += S3RANDOM_SNAPSHOT_ALIGN(section->n_entry *
+                                  sizeof(S3Random_snapshot_record_t));
+
+  if (section->ghost_init) {
+    const S3Random_ghost_t *saved = &section->ghost;
+    S3Random_ghost_t *ghost = state.ghost;
+    S3Random_ghost_init(ghost, saved->n_entry, saved->aging, saved->seed,
+                        saved->filter != NULL);
+    if (ghost->n_bucket != saved->n_bucket ||
+        ghost->n_filter_block != saved->n_filter_block) {
+      S3Random_snapshot_corrupted(path);
+    }
+    memcpy(ghost->buckets, data, sizeof(S3Random_ghost_bucket_t) * ghost->n_bucket);
+    data += S3RANDOM_SNAPSHOT_ALIGN(sizeof(S3Random_ghost_bucket_t) *
+                                    ghost->n_bucket);
+    if (ghost->filter != NULL) {
+      memcpy(ghost->filter, data, (size_t)S3Random_ghost_filter_memory(ghost));
+    }
+    ghost->seq = saved->seq;
+    ghost->n_obj = saved->n_obj;
+    ghost->n_insert = saved->n_insert;
+    ghost->n_lookup = saved->n_lookup;
+    ghost->n_hit = saved->n_hit;
+    ghost->n_filter_negative = saved->n_filter_negative;
+  }
+
+  *state.adapt = section->adapt;
+  *state.stats = section->stats;
+  cache->n_req = section->n_req;
+  if (n_lock_free_hit != NULL) {
+    memcpy(n_lock_free_hit, section->n_lock_free_hit,
+           sizeof(section->n_lock_free_hit));
+  }
+}
+
+bool S3Random_snapshot_load(cache_t *cache, const char *path, int n_thread) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    //no snapshot, the cache starts cold
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(S3Random_snapshot_header_t)) {
+    close(fd);
+    S3Random_snapshot_corrupted(path);
+  }
+  size_t n_byte = (size_t)st.st_size;
+  const uint8_t *data = mmap(NULL, n_byte, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    WARN("S3Random snapshot cannot mmap %s\n", path);
+    close(fd);
+    return false;
+  }
+  madvise((void *)data, n_byte, MADV_WILLNEED);
+
+  const S3Random_snapshot_header_t *header =
+      (const S3Random_snapshot_header_t *)data;
+  cache_t **caches = malloc(sizeof(cache_t *) * S3RANDOM_SNAPSHOT_MAX_SECTION);
+  int64_t **n_lock_free_hit =
+      malloc(sizeof(int64_t *) * S3RANDOM_SNAPSHOT_MAX_SECTION);
+  int n_section = S3Random_snapshot_caches(cache, caches, n_lock_free_hit);
+  const S3Random_snapshot_section_t
+      *sections[S3RANDOM_SNAPSHOT_MAX_SECTION];
+  bool ok = true;
+  if (memcmp(header->magic, S3RANDOM_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != S3RANDOM_SNAPSHOT_VERSION ||
+      header->header_byte != sizeof(S3Random_snapshot_header_t) ||
+      header->section_byte != sizeof(S3Random_snapshot_section_t) ||
+      header->record_byte != sizeof(S3Random_snapshot_record_t)) {
+    WARN("S3Random snapshot %s was not written by this build\n", path);
+    ok = false;
+  } else if (n_section == 0 || header->n_section != n_section ||
+             strcasecmp(header->cache_name, cache->cache_name) != 0 ||
+             header->cache_size != cache->cache_size) {
+    WARN("S3Random snapshot %s is of a %s of %ld bytes with %d sections, "
+         "not of this %s\n",
+         path, header->cache_name, (long)header->cache_size,
+         header->n_section, cache->cache_name);
+    ok = false;
+  }
+
+  //every section is checked before the cache is changed
+  size_t offset = sizeof(S3Random_snapshot_header_t);
+  for (int i = 0; ok && i < n_section; i++) {
+    if (offset + sizeof(S3Random_snapshot_section_t) > n_byte) {
+      S3Random_snapshot_corrupted(path);
+    }
+    const S3Random_snapshot_section_t *section =
+        (const S3Random_snapshot_section_t *)(data + offset);
+    if (section->n_entry < 0 || section->n_entry >= S3RANDOM_NO_SLOT ||
+        section->n_obj[S3RANDOM_SMALL] < 0 || section->n_obj[S3RANDOM_MAIN] < 0 ||
+        section->n_obj[S3RANDOM_SMALL] + section->n_obj[S3RANDOM_MAIN] !=
+            section->n_entry ||
+        section->n_byte != S3Random_snapshot_section_n_byte(section) ||
+        offset + sizeof(S3Random_snapshot_section_t) + section->n_byte >
+            n_byte) {
+      S3Random_snapshot_corrupted(path);
+    }
+    ok = S3Random_snapshot_fits(caches[i], section, path);
+    sections[i] = section;
+    offset += sizeof(S3Random_snapshot_section_t) + section->n_byte;
+  }
+
+  if (ok) {
+    if (n_thread <= 0) {
+      n_thread = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    n_thread = MIN(MAX(n_thread, 1), S3RANDOM_SNAPSHOT_MAX_THREAD);
+    bool sharded = S3Random_snapshot_is_sharded(cache);
+    if (sharded) {
+      S3Randomsharded_lock_all(cache, true);
+    }
+    for (int i = 0; i < n_section; i++) {
+      S3Random_snapshot_load_section(caches[i], sections[i], n_lock_free_hit[i],
+                                     n_thread, path);
+    }
+    if (sharded) {
+      cache->n_req = header->n_req;
+      S3Randomsharded_lock_all(cache, false);
+    }
+  }
+
+  free(n_lock_free_hit);
+  free(caches);
+  munmap((void *)data, n_byte);
+  close(fd);
+  return ok;
+}
+
+#ifdef __cplusplus
+}
+#endif
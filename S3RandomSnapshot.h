@@ -0,0 +1,160 @@
+//  snapshot and warm restart of the S3Random family
+//
+//  a snapshot is the whole state of a cache in a compact binary file, the
+//  objects of small and main with their metadata bits (freq, promoted,
+//  moved_to_main), last access time (if the cache keeps it) and expiration
+//  time, the slots of the ghost, the split between small and main, the
+//  random generators of the queues and the counters, so a cache loaded
+//  from it behaves exactly like the cache that was saved
+//  S3Randomsharded is saved as one section per shard
+//
+//  the file is
+//      header
+//      for each section (one per cache, or per shard)
+//          section header
+//          one 32-byte record per object, in the order of the pool
+//          the buckets of the ghost
+//          the counting filter of the ghost, if it has one
+//  every part starts on 64 bytes, the numbers are in the byte order of the
+//  machine and the sizes of the structures are checked when it is loaded
+//
+//  loading maps the file and rebuilds the pool, the queues and the hash
+//  table in bulk, the records are split between threads that write their
+//  entries and queue slots directly and push the entries on their chains
+//  with an atomic exchange
+//
+//  saving writes from the cache itself, save_background forks and lets the
+//  child write while the parent keeps serving requests, the pages of the
+//  cache are shared copy-on-write so get is only stalled by the fork
+//  the file is written to <path>.tmp and renamed, a crash never leaves a
+//  half-written snapshot
+//
+//
+//  S3RandomSnapshot.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_SNAPSHOT_H
+#define S3RANDOM_SNAPSHOT_H
+
+#include <sys/types.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomAdapt.h"
+#include "S3RandomGhost.h"
+#include "S3RandomIndex.h"
+#include "S3RandomStats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define S3RANDOM_SNAPSHOT_MAGIC "S3RSNAP"
+#define S3RANDOM_SNAPSHOT_VERSION 2
+// the most sections, the most shards of S3Randomsharded
+#define S3RANDOM_SNAPSHOT_MAX_SECTION 1024
+// the records loaded by each thread at least
+#define S3RANDOM_SNAPSHOT_THREAD_MIN (1 << 16)
+#define S3RANDOM_SNAPSHOT_MAX_THREAD 16
+
+// what a snapshot reads and writes in a cache, the queues are reached from
+// the index
+typedef struct {
+  S3Random_index_t *index;
+  S3Random_ghost_t *ghost;
+  S3Random_adapt_t *adapt;
+  S3Random_stats_t *stats;
+} S3Random_state_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  // the sizes of the structures, a snapshot is only loaded by a build
+  // with the same layout
+  uint32_t header_byte;
+  uint32_t section_byte;
+  uint32_t record_byte;
+  int32_t n_section;
+  char cache_name[CACHE_NAME_ARRAY_LEN];
+  int64_t cache_size;
+  // the requests of the whole cache, the shards of S3Randomsharded only
+  // count their own
+  int64_t n_req;
+} __attribute__((aligned(64))) S3Random_snapshot_header_t;
+
+typedef struct {
+  char cache_name[CACHE_NAME_ARRAY_LEN];
+  int64_t cache_size;
+  int32_t obj_md_size;
+  bool ghost_init;
+  int64_t n_req;
+  // the clock time of the last request, see S3Random_entry_expired
+  int64_t clock_time;
+  // the virtual time of S3Randomtwo
+  int64_t vtime;
+  int64_t n_entry;
+  int64_t n_obj[S3RANDOM_N_QUEUE];
+  int64_t queue_cache_size[S3RANDOM_N_QUEUE];
+  S3Random_rng_t rng[S3RANDOM_N_QUEUE];
+  S3Random_adapt_t adapt;
+  S3Random_stats_t stats;
+  // the hits S3Randomsharded served without the lock of this shard
+  int64_t n_lock_free_hit[S3RANDOM_N_QUEUE];
+  // the pointers are not used, the ghost is allocated again
+  S3Random_ghost_t ghost;
+  // the bytes of the section after its header
+  int64_t n_byte;
+} __attribute__((aligned(64))) S3Random_snapshot_section_t;
+
+typedef struct {
+  uint64_t obj_id;
+  // 0 if the index does not track it
+  int64_t last_access_vtime;
+  uint32_t obj_size;
+  // the position in the array of its queue
+  uint32_t pos;
+  // the clock time it expires at, 0 if it has no ttl
+  uint32_t exp_time;
+  // S3Random_md_t
+  uint8_t md;
+  uint8_t pad[3];
+} S3Random_snapshot_record_t;
+
+/**
+ * @brief write a snapshot of a S3Random, S3Randomtwo, S3Randomfreq or
+ * S3Randomsharded cache, the shards are locked while they are written
+ *
+ * @return false if the file cannot be written
+ */
+bool S3Random_snapshot_save(cache_t *cache, const char *path);
+
+/**
+ * @brief write a snapshot from a child process, the cache can be used as
+ * soon as this returns
+ *
+ * @return the pid of the child, -1 if it cannot be forked
+ */
+pid_t S3Random_snapshot_save_background(cache_t *cache, const char *path);
+
+/**
+ * @brief wait for a snapshot written in the background
+ *
+ * @return false if it could not be written
+ */
+bool S3Random_snapshot_wait(pid_t pid);
+
+/**
+ * @brief load a snapshot into a cache that was just created with the same
+ * algorithm, size and parameters
+ *
+ * @param n_thread the threads that rebuild the index, 0 picks one per core
+ * @return false if there is no snapshot or it does not fit the cache, the
+ * cache is then left empty, it exits if the snapshot is corrupted
+ */
+bool S3Random_snapshot_load(cache_t *cache, const char *path, int n_thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_SNAPSHOT_H
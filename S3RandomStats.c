@@ -0,0 +1,175 @@
+//  statistics of the internals of the S3Random family
+//  see S3RandomStats.h
+//
+//
+//  S3RandomStats.c
+//  libCacheSim
+//
+
+#include <stddef.h>
+
+#include "S3RandomStats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void S3Random_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+void S3Randomtwo_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+void S3Randomfreq_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+void S3Randomsharded_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+
+// the columns of the time series, in the order they are written
+typedef struct {
+  const char *name;
+  size_t offset;
+  bool is_double;
+  // the buckets of a histogram, 1 for a counter
+  int n;
+} S3Random_stats_field_t;
+
+#define S3RANDOM_STATS_FIELD(name) \
+  { #name, offsetof(S3Random_stats_t, name), false, 1 }
+#define S3RANDOM_STATS_HIST(name)                  \
+  {                                                \
+    #name, offsetof(S3Random_stats_t, name), false, \
+        S3RANDOM_STATS_ITER_HIST_SIZE              \
+  }
+
+static const S3Random_stats_field_t S3Random_stats_fields[] = {
+    S3RANDOM_STATS_FIELD(n_req),
+    S3RANDOM_STATS_FIELD(n_warmup_req),
+    S3RANDOM_STATS_FIELD(n_hit_small),
+    S3RANDOM_STATS_FIELD(n_hit_main),
+    S3RANDOM_STATS_FIELD(n_ghost_hit),
+    {"n_ghost_false_positive",
+     offsetof(S3Random_stats_t, n_ghost_false_positive), true, 1},
+    S3RANDOM_STATS_FIELD(n_ghost_filter_negative),
+    S3RANDOM_STATS_FIELD(n_ghost_filter_false_positive),
+    S3RANDOM_STATS_FIELD(n_obj_admit_to_small),
+    S3RANDOM_STATS_FIELD(n_obj_admit_to_main),
+    S3RANDOM_STATS_FIELD(n_obj_move_to_main),
+    S3RANDOM_STATS_FIELD(n_byte_admit_to_small),
+    S3RANDOM_STATS_FIELD(n_byte_admit_to_main),
+    S3RANDOM_STATS_FIELD(n_byte_move_to_main),
+    S3RANDOM_STATS_FIELD(n_obj_admit_large),
+    S3RANDOM_STATS_FIELD(n_byte_admit_large),
+    S3RANDOM_STATS_FIELD(n_evict_small),
+    S3RANDOM_STATS_FIELD(n_evict_main),
+    S3RANDOM_STATS_FIELD(n_second_chance),
+    S3RANDOM_STATS_FIELD(n_expire_find),
+    S3RANDOM_STATS_FIELD(n_expire_evict),
+    S3RANDOM_STATS_HIST(evict_main_iter),
+    S3RANDOM_STATS_HIST(evict_small_iter),
+    S3RANDOM_STATS_FIELD(max_evict_main_iter),
+    S3RANDOM_STATS_FIELD(max_evict_small_iter),
+    S3RANDOM_STATS_FIELD(small_n_obj),
+    S3RANDOM_STATS_FIELD(small_occupied_byte),
+    S3RANDOM_STATS_FIELD(small_cache_size),
+    S3RANDOM_STATS_FIELD(main_n_obj),
+    S3RANDOM_STATS_FIELD(main_occupied_byte),
+    S3RANDOM_STATS_FIELD(main_cache_size),
+    S3RANDOM_STATS_FIELD(ghost_n_obj),
+    S3RANDOM_STATS_FIELD(ghost_filter_byte),
+};
+
+#define S3RANDOM_STATS_N_FIELD \
+  (sizeof(S3Random_stats_fields) / sizeof(S3Random_stats_fields[0]))
+
+void S3Random_stats_get(const cache_t *cache, S3Random_stats_t *stats) {
+  memset(stats, 0, sizeof(S3Random_stats_t));
+  if (strcasecmp(cache->cache_name, "S3Random") == 0) {
+    S3Random_get_stats(cache, stats);
+  } else if (strcasecmp(cache->cache_name, "S3Randomtwo") == 0) {
+    S3Randomtwo_get_stats(cache, stats);
+  } else if (strcasecmp(cache->cache_name, "S3Randomfreq") == 0) {
+    S3Randomfreq_get_stats(cache, stats);
+  } else if (strcasecmp(cache->cache_name, "S3Randomsharded") == 0) {
+    S3Randomsharded_get_stats(cache, stats);
+  } else {
+    ERROR("%s is not a S3Random cache\n", cache->cache_name);
+    exit(1);
+  }
+}
+
+int S3Random_stats_format_parse(const char *name) {
+  if (strcasecmp(name, "csv") == 0) {
+    return S3RANDOM_STATS_CSV;
+  } else if (strcasecmp(name, "json") == 0) {
+    return S3RANDOM_STATS_JSON;
+  }
+  return -1;
+}
+
+void S3Random_stats_recorder_init(S3Random_stats_recorder_t *recorder,
+                                  FILE *out,
+                                  const S3Random_stats_format_e format,
+                                  const int64_t interval) {
+  memset(recorder, 0, sizeof(S3Random_stats_recorder_t));
+  recorder->out = out;
+  recorder->format = format;
+  recorder->interval = interval > 0 ? interval : 1;
+  recorder->next_n_req = recorder->interval;
+
+  if (format == S3RANDOM_STATS_CSV) {
+    for (size_t i = 0; i < S3RANDOM_STATS_N_FIELD; i++) {
+      const S3Random_stats_field_t *field = &S3Random_stats_fields[i];
+      if (field->n == 1) {
+        fprintf(out, "%s%s", i == 0 ? "" : ",", field->name);
+        continue;
+      }
+      for (int b = 0; b < field->n; b++) {
+        fprintf(out, "%s%s_%d", i == 0 && b == 0 ? "" : ",", field->name, b);
+      }
+    }
+    fprintf(out, "\n");
+  } else {
+    fprintf(out, "[");
+  }
+}
+
+void S3Random_stats_recorder_snapshot(S3Random_stats_recorder_t *recorder,
+                                      const cache_t *cache) {
+  S3Random_stats_t stats;
+  S3Random_stats_get(cache, &stats);
+  FILE *out = recorder->out;
+  bool json = recorder->format == S3RANDOM_STATS_JSON;
+
+  if (json) {
+    fprintf(out, "%s\n  {", recorder->n_snapshot == 0 ? "" : ",");
+  }
+  for (size_t i = 0; i < S3RANDOM_STATS_N_FIELD; i++) {
+    const S3Random_stats_field_t *field = &S3Random_stats_fields[i];
+    const char *value = (const char *)&stats + field->offset;
+    if (json) {
+      fprintf(out, "%s\"%s\": ", i == 0 ? "" : ", ", field->name);
+    } else if (i > 0) {
+      fprintf(out, ",");
+    }
+    if (field->is_double) {
+      fprintf(out, "%.6g", *(const double *)value);
+    } else if (field->n == 1) {
+      fprintf(out, "%lld", (long long)*(const int64_t *)value);
+    } else {
+      const int64_t *hist = (const int64_t *)value;
+      fprintf(out, "%s", json ? "[" : "");
+      for (int b = 0; b < field->n; b++) {
+        fprintf(out, "%s%lld", b == 0 ? "" : ",", (long long)hist[b]);
+      }
+      fprintf(out, "%s", json ? "]" : "");
+    }
+  }
+  fprintf(out, json ? "}" : "\n");
+  recorder->n_snapshot += 1;
+}
+
+void S3Random_stats_recorder_close(S3Random_stats_recorder_t *recorder) {
+  if (recorder->format == S3RANDOM_STATS_JSON) {
+    fprintf(recorder->out, "\n]\n");
+  }
+  fflush(recorder->out);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,246 @@
+//  statistics of the internals of the S3Random family
+//
+//  every cache counts its events in a S3Random_stats_t of its params with
+//  plain increments, a cache is only used by one thread (a shard of
+//  S3Randomsharded is used under its lock) so the hot path pays no atomic,
+//  only the lock-free hits of S3Randomsharded are counted per shard with a
+//  relaxed atomic add
+//  S3Random_stats_get reads the counters of a cache, sums the shards of
+//  S3Randomsharded, and adds the occupancy of the queues
+//
+//  the counters are added with S3RANDOM_STATS_ADD, find, insert and evict
+//  are built twice, with warm false for the normal path and true for the
+//  warmup (see S3RandomWarmup.h), warm is a constant of each build so the
+//  test is folded away and neither path branches on it
+//
+//  a recorder snapshots the stats every interval requests and writes them
+//  as a time series, one CSV row or one JSON object per snapshot, a
+//  histogram is one column per bucket (name_0, name_1, ...) in CSV and an
+//  array in JSON
+//
+//
+//  S3RandomStats.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_STATS_H
+#define S3RANDOM_STATS_H
+
+#include <stdio.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomGhost.h"
+#include "S3RandomIndex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// buckets of the histograms of the candidates per eviction
+#define S3RANDOM_STATS_ITER_HIST_SIZE 32
+
+typedef struct {
+  // the requests after the warmup, see S3RandomWarmup.h
+  int64_t n_req;
+  // the requests of the warmup
+  int64_t n_warmup_req;
+  int64_t n_hit_small;
+  int64_t n_hit_main;
+  // misses that found the object in the ghost and went to main
+  int64_t n_ghost_hit;
+  // the expected number of ghost hits that matched the fingerprint of
+  // another key, see S3Random_ghost_fp_rate
+  double n_ghost_false_positive;
+  // ghost lookups the filter answered without reading the ghost, and the
+  // ones it let through that were not in the ghost, with ghost-filter=1
+  int64_t n_ghost_filter_negative;
+  int64_t n_ghost_filter_false_positive;
+
+  int64_t n_obj_admit_to_small;
+  int64_t n_obj_admit_to_main;
+  int64_t n_obj_move_to_main;
+  int64_t n_byte_admit_to_small;
+  int64_t n_byte_admit_to_main;
+  int64_t n_byte_move_to_main;
+  // admitted to main because they are too large for small, they are also
+  // counted in admit_to_main
+  int64_t n_obj_admit_large;
+  int64_t n_byte_admit_large;
+
+  // evicted from small to the ghost
+  int64_t n_evict_small;
+  int64_t n_evict_main;
+  // candidates of main kept because they were accessed, S3Randomfreq
+  int64_t n_second_chance;
+  // expired objects reclaimed when they were requested, and before a live
+  // object was evicted
+  int64_t n_expire_find;
+  int64_t n_expire_evict;
+  // the candidates looked at per eviction of main and of small, bucket b
+  // counts the evictions that looked at 2^b to 2^(b+1)-1 of them, and the
+  // most of one eviction, S3Randomfreq
+  int64_t evict_main_iter[S3RANDOM_STATS_ITER_HIST_SIZE];
+  int64_t evict_small_iter[S3RANDOM_STATS_ITER_HIST_SIZE];
+  int64_t max_evict_main_iter;
+  int64_t max_evict_small_iter;
+
+  // the occupancy when the stats are read
+  int64_t small_n_obj;
+  int64_t small_occupied_byte;
+  int64_t small_cache_size;
+  int64_t main_n_obj;
+  int64_t main_occupied_byte;
+  int64_t main_cache_size;
+  int64_t ghost_n_obj;
+  int64_t ghost_filter_byte;
+} S3Random_stats_t;
+
+typedef enum {
+  S3RANDOM_STATS_CSV = 0,
+  S3RANDOM_STATS_JSON = 1,
+} S3Random_stats_format_e;
+
+typedef struct {
+  FILE *out;
+  S3Random_stats_format_e format;
+  // requests between two snapshots
+  int64_t interval;
+  int64_t next_n_req;
+  int64_t n_snapshot;
+} S3Random_stats_recorder_t;
+
+// add n to a counter of the stats of a cache, params is the params of the
+// variant, warm is the constant the function was built with
+#define S3RANDOM_STATS_ADD(params, warm, field, n) \
+  do {                                             \
+    if (!(warm)) {                                 \
+      (params)->stats.field += (n);                \
+    }                                              \
+  } while (0)
+
+/**
+ * @brief add the counters of src to dst, the occupancy too, the maxima are
+ * the larger of the two
+ */
+static inline void S3Random_stats_add(S3Random_stats_t *dst,
+                                      const S3Random_stats_t *src) {
+  dst->n_req += src->n_req;
+  dst->n_warmup_req += src->n_warmup_req;
+  dst->n_hit_small += src->n_hit_small;
+  dst->n_hit_main += src->n_hit_main;
+  dst->n_ghost_hit += src->n_ghost_hit;
+  dst->n_ghost_false_positive += src->n_ghost_false_positive;
+  dst->n_ghost_filter_negative += src->n_ghost_filter_negative;
+  dst->n_ghost_filter_false_positive += src->n_ghost_filter_false_positive;
+  dst->n_obj_admit_to_small += src->n_obj_admit_to_small;
+  dst->n_obj_admit_to_main += src->n_obj_admit_to_main;
+  dst->n_obj_move_to_main += src->n_obj_move_to_main;
+  dst->n_byte_admit_to_small += src->n_byte_admit_to_small;
+  dst->n_byte_admit_to_main += src->n_byte_admit_to_main;
+  dst->n_byte_move_to_main += src->n_byte_move_to_main;
+  dst->n_obj_admit_large += src->n_obj_admit_large;
+  dst->n_byte_admit_large += src->n_byte_admit_large;
+  dst->n_evict_small += src->n_evict_small;
+  dst->n_evict_main += src->n_evict_main;
+  dst->n_second_chance += src->n_second_chance;
+  dst->n_expire_find += src->n_expire_find;
+  dst->n_expire_evict += src->n_expire_evict;
+  for (int i = 0; i < S3RANDOM_STATS_ITER_HIST_SIZE; i++) {
+    dst->evict_main_iter[i] += src->evict_main_iter[i];
+    dst->evict_small_iter[i] += src->evict_small_iter[i];
+  }
+  dst->max_evict_main_iter =
+      MAX(dst->max_evict_main_iter, src->max_evict_main_iter);
+  dst->max_evict_small_iter =
+      MAX(dst->max_evict_small_iter, src->max_evict_small_iter);
+  dst->small_n_obj += src->small_n_obj;
+  dst->small_occupied_byte += src->small_occupied_byte;
+  dst->small_cache_size += src->small_cache_size;
+  dst->main_n_obj += src->main_n_obj;
+  dst->main_occupied_byte += src->main_occupied_byte;
+  dst->main_cache_size += src->main_cache_size;
+  dst->ghost_n_obj += src->ghost_n_obj;
+  dst->ghost_filter_byte += src->ghost_filter_byte;
+}
+
+/**
+ * @brief the counters of a cache and the occupancy of its queues, used by
+ * the variants to implement their stats function
+ */
+static inline void S3Random_stats_read(S3Random_stats_t *stats,
+                                       const S3Random_stats_t *counters,
+                                       const cache_t *cache,
+                                       const S3Random_queue_t *small,
+                                       const S3Random_queue_t *main,
+                                       const S3Random_ghost_t *ghost) {
+  *stats = *counters;
+  stats->n_req = cache->n_req - counters->n_warmup_req;
+  stats->n_ghost_false_positive =
+      (double)ghost->n_lookup * S3Random_ghost_fp_rate(ghost);
+  stats->n_ghost_filter_negative = ghost->n_filter_negative;
+  stats->n_ghost_filter_false_positive = S3Random_ghost_filter_n_fp(ghost);
+  stats->small_n_obj = small->n_obj;
+  stats->small_occupied_byte = small->occupied_byte;
+  stats->small_cache_size = small->cache_size;
+  stats->main_n_obj = main->n_obj;
+  stats->main_occupied_byte = main->occupied_byte;
+  stats->main_cache_size = main->cache_size;
+  stats->ghost_n_obj = MIN(ghost->n_obj, ghost->n_entry);
+  stats->ghost_filter_byte = S3Random_ghost_filter_memory(ghost);
+}
+
+/**
+ * @brief read the stats of a S3Random, S3Randomtwo, S3Randomfreq or
+ * S3Randomsharded cache
+ */
+void S3Random_stats_get(const cache_t *cache, S3Random_stats_t *stats);
+
+/**
+ * @brief parse the name of a format, csv or json
+ *
+ * @return the format or -1 if the name is unknown
+ */
+int S3Random_stats_format_parse(const char *name);
+
+/**
+ * @brief start a time series, the CSV header or the opening bracket of the
+ * JSON array is written now
+ *
+ * @param interval requests between two snapshots
+ */
+void S3Random_stats_recorder_init(S3Random_stats_recorder_t *recorder,
+                                  FILE *out,
+                                  const S3Random_stats_format_e format,
+                                  const int64_t interval);
+
+/**
+ * @brief write one snapshot of the stats of the cache
+ */
+void S3Random_stats_recorder_snapshot(S3Random_stats_recorder_t *recorder,
+                                      const cache_t *cache);
+
+/**
+ * @brief call after each request, it only reads the stats every interval
+ * requests
+ *
+ * @param n_req the number of requests given to the cache so far
+ */
+static inline void S3Random_stats_recorder_tick(
+    S3Random_stats_recorder_t *recorder, const cache_t *cache,
+    const int64_t n_req) {
+  if (n_req >= recorder->next_n_req) {
+    recorder->next_n_req = n_req + recorder->interval;
+    S3Random_stats_recorder_snapshot(recorder, cache);
+  }
+}
+
+/**
+ * @brief end the time series, the file is flushed but not closed
+ */
+void S3Random_stats_recorder_close(S3Random_stats_recorder_t *recorder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_STATS_H
@@ -0,0 +1,205 @@
+//  replay a binary trace through a cache at the speed of the cache
+//  see S3RandomTrace.h
+//
+//
+//  S3RandomTrace.c
+//  libCacheSim
+//
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "S3RandomTrace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief wait a little for the other thread, spin first and then give the
+ * core away
+ */
+static inline void S3Random_trace_relax(int *n_spin) {
+  if (*n_spin < 64) {
+    *n_spin += 1;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else {
+    sched_yield();
+  }
+}
+
+static inline void S3Random_trace_decode(const uint8_t *record,
+                                         request_t *req) {
+  uint32_t clock_time, obj_size;
+  uint64_t obj_id;
+  int64_t next_access_vtime;
+  //the records are packed, memcpy reads them unaligned
+  memcpy(&clock_time, record, sizeof(clock_time));
+  memcpy(&obj_id, record + 4, sizeof(obj_id));
+  memcpy(&obj_size, record + 12, sizeof(obj_size));
+  memcpy(&next_access_vtime, record + 16, sizeof(next_access_vtime));
+  req->clock_time = clock_time;
+  req->obj_id = obj_id;
+  req->obj_size = obj_size;
+  req->next_access_vtime = next_access_vtime;
+  req->op = OP_GET;
+  req->valid = true;
+}
+
+static void *S3Random_trace_producer(void *arg) {
+  S3Random_trace_t *trace = (S3Random_trace_t *)arg;
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  int64_t pos = 0;
+  size_t dropped = 0;
+  uint64_t head = 0;
+
+  while (true) {
+    //wait for a free batch
+    int n_spin = 0;
+    while (head - __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE) ==
+           S3RANDOM_TRACE_RING_SIZE) {
+      if (__atomic_load_n(&trace->stop, __ATOMIC_RELAXED)) {
+        return NULL;
+      }
+      S3Random_trace_relax(&n_spin);
+    }
+
+    S3Random_trace_batch_t *batch =
+        &trace->ring[head & (S3RANDOM_TRACE_RING_SIZE - 1)];
+    int n = (int)MIN(trace->n_req - pos, S3RANDOM_TRACE_BATCH_SIZE);
+    const uint8_t *record = trace->data + pos * S3RANDOM_TRACE_RECORD_SIZE;
+    for (int i = 0; i < n; i++) {
+      S3Random_trace_decode(record, &batch->reqs[i]);
+      record += S3RANDOM_TRACE_RECORD_SIZE;
+    }
+    batch->n_req = n;
+    pos += n;
+    head += 1;
+    __atomic_store_n(&trace->head, head, __ATOMIC_RELEASE);
+    //an empty batch is the end of the trace
+    if (n == 0) {
+      return NULL;
+    }
+
+    //the pages that were decoded are not needed anymore
+    size_t decoded = (size_t)pos * S3RANDOM_TRACE_RECORD_SIZE;
+    if (decoded - dropped >= S3RANDOM_TRACE_DROP_BYTE) {
+      size_t end = decoded & ~(page_size - 1);
+      madvise((void *)(trace->data + dropped), end - dropped, MADV_DONTNEED);
+      dropped = end;
+    }
+  }
+}
+
+S3Random_trace_t *S3Random_trace_open(const char *path) {
+  S3Random_trace_t *trace = malloc(sizeof(S3Random_trace_t));
+  memset(trace, 0, sizeof(S3Random_trace_t));
+  trace->path = path;
+  trace->fd = open(path, O_RDONLY);
+  struct stat st;
+  if (trace->fd < 0 || fstat(trace->fd, &st) != 0) {
+    ERROR("S3Random trace cannot open %s\n", path);
+    exit(1);
+  }
+  trace->n_byte = (size_t)st.st_size;
+  if (trace->n_byte % S3RANDOM_TRACE_RECORD_SIZE != 0) {
+    ERROR("S3Random trace %s is not made of %d-byte records\n", path,
+          S3RANDOM_TRACE_RECORD_SIZE);
+    exit(1);
+  }
+  trace->n_req = (int64_t)(trace->n_byte / S3RANDOM_TRACE_RECORD_SIZE);
+
+  if (trace->n_byte > 0) {
+    void *data =
+        mmap(NULL, trace->n_byte, PROT_READ, MAP_PRIVATE, trace->fd, 0);
+    if (data == MAP_FAILED) {
+      ERROR("S3Random trace cannot mmap %s\n", path);
+      exit(1);
+    }
+    madvise(data, trace->n_byte, MADV_SEQUENTIAL);
+    trace->data = (const uint8_t *)data;
+  }
+
+  trace->ring = calloc(S3RANDOM_TRACE_RING_SIZE, sizeof(S3Random_trace_batch_t));
+  return trace;
+}
+
+/**
+ * @brief stop the producer if it runs
+ */
+static void S3Random_trace_stop(S3Random_trace_t *trace) {
+  if (trace->started) {
+    __atomic_store_n(&trace->stop, true, __ATOMIC_RELAXED);
+    pthread_join(trace->producer, NULL);
+    trace->started = false;
+  }
+}
+
+void S3Random_trace_start(S3Random_trace_t *trace) {
+  S3Random_trace_stop(trace);
+  trace->head = 0;
+  trace->tail = 0;
+  trace->stop = false;
+  if (trace->n_byte > 0) {
+    madvise((void *)trace->data, trace->n_byte, MADV_WILLNEED);
+  }
+  pthread_create(&trace->producer, NULL, S3Random_trace_producer, trace);
+  trace->started = true;
+}
+
+const S3Random_trace_batch_t *S3Random_trace_next_batch(
+    S3Random_trace_t *trace) {
+  //only this thread writes the tail
+  uint64_t tail = trace->tail;
+  int n_spin = 0;
+  while (__atomic_load_n(&trace->head, __ATOMIC_ACQUIRE) == tail) {
+    S3Random_trace_relax(&n_spin);
+  }
+  const S3Random_trace_batch_t *batch =
+      &trace->ring[tail & (S3RANDOM_TRACE_RING_SIZE - 1)];
+  return batch->n_req == 0 ? NULL : batch;
+}
+
+void S3Random_trace_release_batch(S3Random_trace_t *trace) {
+  __atomic_store_n(&trace->tail, trace->tail + 1, __ATOMIC_RELEASE);
+}
+
+void S3Random_trace_replay(S3Random_trace_t *trace, cache_t *cache,
+                           S3Random_trace_result_t *result) {
+  memset(result, 0, sizeof(S3Random_trace_result_t));
+  S3Random_trace_start(trace);
+  const S3Random_trace_batch_t *batch;
+  while ((batch = S3Random_trace_next_batch(trace)) != NULL) {
+    for (int i = 0; i < batch->n_req; i++) {
+      const request_t *req = &batch->reqs[i];
+      bool hit = cache->get(cache, req);
+      result->n_byte += req->obj_size;
+      if (!hit) {
+        result->n_miss += 1;
+        result->n_miss_byte += req->obj_size;
+      }
+    }
+    result->n_req += batch->n_req;
+    S3Random_trace_release_batch(trace);
+  }
+  S3Random_trace_stop(trace);
+}
+
+void S3Random_trace_close(S3Random_trace_t *trace) {
+  S3Random_trace_stop(trace);
+  if (trace->n_byte > 0) {
+    munmap((void *)trace->data, trace->n_byte);
+  }
+  close(trace->fd);
+  free(trace->ring);
+  free(trace);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,108 @@
+//  replay a binary trace through a cache at the speed of the cache
+//
+//  the trace is mmap'ed, a producer thread decodes the records into
+//  batches of request_t and hands them to the thread of the cache through
+//  a single-producer/single-consumer ring, so the cache thread only runs
+//  get, the batches are allocated once and reused
+//  the kernel is told that the trace is read sequentially, and the pages
+//  that were decoded are dropped so that a trace larger than the memory
+//  can be replayed
+//
+//  the records are the fixed 24 bytes of the oracleGeneral format of
+//  libCacheSim, little endian and packed
+//      uint32_t clock_time;  uint64_t obj_id;  uint32_t obj_size;
+//      int64_t next_access_vtime;
+//
+//
+//  S3RandomTrace.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_TRACE_H
+#define S3RANDOM_TRACE_H
+
+#include <pthread.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// requests in a batch
+#define S3RANDOM_TRACE_BATCH_SIZE 4096
+// batches in the ring, a power of 2
+#define S3RANDOM_TRACE_RING_SIZE 8
+// bytes of the trace decoded before they are dropped from memory
+#define S3RANDOM_TRACE_DROP_BYTE (16 << 20)
+#define S3RANDOM_TRACE_RECORD_SIZE 24
+
+typedef struct {
+  request_t reqs[S3RANDOM_TRACE_BATCH_SIZE];
+  // 0 is the end of the trace
+  int n_req;
+} S3Random_trace_batch_t;
+
+typedef struct {
+  const char *path;
+  int fd;
+  const uint8_t *data;
+  size_t n_byte;
+  int64_t n_req;
+
+  S3Random_trace_batch_t *ring;
+  // head is written by the producer and tail by the consumer, they count
+  // the batches and are on their own cache lines
+  uint64_t head __attribute__((aligned(64)));
+  uint64_t tail __attribute__((aligned(64)));
+  bool stop __attribute__((aligned(64)));
+  pthread_t producer;
+  bool started;
+} S3Random_trace_t;
+
+typedef struct {
+  int64_t n_req;
+  int64_t n_miss;
+  int64_t n_byte;
+  int64_t n_miss_byte;
+} S3Random_trace_result_t;
+
+/**
+ * @brief map a trace, exits if it cannot be read
+ */
+S3Random_trace_t *S3Random_trace_open(const char *path);
+
+/**
+ * @brief start the producer thread, the trace is replayed from the start
+ */
+void S3Random_trace_start(S3Random_trace_t *trace);
+
+/**
+ * @brief the next batch of the trace, it waits for the producer
+ *
+ * @return NULL at the end of the trace
+ */
+const S3Random_trace_batch_t *S3Random_trace_next_batch(
+    S3Random_trace_t *trace);
+
+/**
+ * @brief give the batch returned by next_batch back to the producer
+ */
+void S3Random_trace_release_batch(S3Random_trace_t *trace);
+
+/**
+ * @brief replay the whole trace through the cache
+ */
+void S3Random_trace_replay(S3Random_trace_t *trace, cache_t *cache,
+                           S3Random_trace_result_t *result);
+
+/**
+ * @brief stop the producer and unmap the trace
+ */
+void S3Random_trace_close(S3Random_trace_t *trace);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_TRACE_H
@@ -0,0 +1,114 @@
+//  warmup phase of the S3Random family
+//
+//  the first requests of a replay only fill the cache, with warmup=<n> or
+//  warmup-sec=<s> a cache serves them with a fast get that calls its find,
+//  evict and insert directly instead of going through cache_get_base and
+//  the function pointers of the cache, and skips the debug assertions and
+//  the latency histograms of get, find and insert
+//  the warmup ends after n requests or s seconds after its first request,
+//  whichever comes first, the clock is only read every
+//  S3RANDOM_WARMUP_CLOCK_INTERVAL requests
+//  each variant builds find, insert and evict twice from one always-inline
+//  body with a constant warm parameter (S3RANDOM_WARM_INLINE), the warmup
+//  versions skip the counters of the stats (S3RANDOM_STATS_ADD) and the
+//  normal ones have no test of the warmup left, while it runs the function
+//  pointers of the cache are the warmup versions, so S3Randomsharded
+//  reaches them too
+//  when it ends, the request that ends it resets every counter of the
+//  cache (the stats, the counters of the ghost and of the adaptive split,
+//  the latency histograms) and puts the normal get, find, insert and evict
+//  back, so the stats only cover the requests after the warmup
+//  the state of the cache (objects, ghost, split, random generators) is
+//  exactly the one the normal get would have built, n_req keeps counting
+//  since S3Randomtwo ages its objects by it, the stats subtract the
+//  requests of the warmup
+//
+//
+//  S3RandomWarmup.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_WARMUP_H
+#define S3RANDOM_WARMUP_H
+
+#include <time.h>
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomAdapt.h"
+#include "S3RandomGhost.h"
+#include "S3RandomStats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// requests between two reads of the clock, a power of 2
+#define S3RANDOM_WARMUP_CLOCK_INTERVAL 1024
+// the body shared by the normal and the warmup versions of a function, it
+// is inlined into both so its warm parameter is a constant
+#define S3RANDOM_WARM_INLINE __attribute__((always_inline))
+
+typedef struct {
+  // the requests of the warmup, 0 if it is not limited by requests
+  int64_t n_req;
+  // the seconds of the warmup, 0 if it is not limited by time
+  double sec;
+  // the time it ends, set by its first request
+  double end_time;
+  // the requests served since it started
+  int64_t n_done;
+} S3Random_warmup_t;
+
+static inline double S3Random_warmup_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static inline bool S3Random_warmup_enabled(const S3Random_warmup_t *warmup) {
+  return warmup->n_req > 0 || warmup->sec > 0;
+}
+
+/**
+ * @brief count a request of the warmup
+ *
+ * @return true if the warmup ends with this request
+ */
+static inline bool S3Random_warmup_tick(S3Random_warmup_t *warmup) {
+  warmup->n_done += 1;
+  if (warmup->n_req > 0 && warmup->n_done >= warmup->n_req) {
+    return true;
+  }
+  if (warmup->sec > 0) {
+    if (warmup->end_time == 0) {
+      warmup->end_time = S3Random_warmup_now() + warmup->sec;
+    } else if ((warmup->n_done & (S3RANDOM_WARMUP_CLOCK_INTERVAL - 1)) == 0 &&
+               S3Random_warmup_now() >= warmup->end_time) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief reset the counters a cache shares with the other variants, the
+ * requests served so far are remembered in n_warmup_req
+ */
+static inline void S3Random_warmup_reset(const cache_t *cache,
+                                         S3Random_stats_t *stats,
+                                         S3Random_ghost_t *ghost,
+                                         S3Random_adapt_t *adapt) {
+  memset(stats, 0, sizeof(S3Random_stats_t));
+  stats->n_warmup_req = cache->n_req;
+  ghost->n_insert = 0;
+  ghost->n_lookup = 0;
+  ghost->n_hit = 0;
+  ghost->n_filter_negative = 0;
+  adapt->n_rebalance = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_WARMUP_H
@@ -0,0 +1,457 @@
+//  synthetic workloads generated in memory and replayed through a cache
+//  see S3RandomWorkload.h
+//
+//
+//  S3RandomWorkload.c
+//  libCacheSim
+//
+
+#include <math.h>
+
+#include "S3RandomWorkload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the keys of each part of the mix are apart in the high bits
+typedef enum {
+  S3RANDOM_WORKLOAD_POPULAR = 0,
+  S3RANDOM_WORKLOAD_ONE_HIT = 1,
+  S3RANDOM_WORKLOAD_LOOP = 2,
+  S3RANDOM_WORKLOAD_SCAN = 3,
+} S3Random_workload_part_e;
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                         distributions                         ****
+// ****                                                               ****
+// ***********************************************************************
+
+static inline double S3Random_uniform(S3Random_rng_t *rng) {
+  return (double)(S3Random_rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * @brief build the alias table of the weights with Vose's method
+ */
+static void S3Random_alias_init(S3Random_alias_t *table, const double *weight,
+                                const uint32_t n) {
+  table->n = n;
+  table->prob = malloc(sizeof(uint32_t) * n);
+  table->alias = malloc(sizeof(uint32_t) * n);
+  double *p = malloc(sizeof(double) * n);
+  // the columns below and above the average, from both ends of one array
+  uint32_t *stack = malloc(sizeof(uint32_t) * n);
+  uint32_t n_small = 0, n_large = 0;
+
+  double sum = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sum += weight[i];
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    p[i] = weight[i] * n / sum;
+    if (p[i] < 1) {
+      stack[n_small++] = i;
+    } else {
+      stack[n - 1 - n_large++] = i;
+    }
+  }
+
+  while (n_small > 0 && n_large > 0) {
+    uint32_t s = stack[--n_small];
+    uint32_t l = stack[n - n_large];
+    table->prob[s] = (uint32_t)MIN(p[s] * 4294967296.0, 4294967295.0);
+    table->alias[s] = l;
+    p[l] = p[l] + p[s] - 1;
+    if (p[l] < 1) {
+      n_large -= 1;
+      stack[n_small++] = l;
+    }
+  }
+  //what is left is 1 up to the rounding, it keeps its own column
+  while (n_small > 0) {
+    uint32_t s = stack[--n_small];
+    table->prob[s] = UINT32_MAX;
+    table->alias[s] = s;
+  }
+  while (n_large > 0) {
+    uint32_t l = stack[n - n_large--];
+    table->prob[l] = UINT32_MAX;
+    table->alias[l] = l;
+  }
+
+  free(stack);
+  free(p);
+}
+
+/**
+ * @brief a column of the table, r is a random 64-bit number, the high half
+ * picks the column and the low half flips the coin
+ */
+static inline uint32_t S3Random_alias_draw(const S3Random_alias_t *table,
+                                           const uint64_t r) {
+  uint32_t col = (uint32_t)(((r >> 32) * table->n) >> 32);
+  return (uint32_t)r < table->prob[col] ? col : table->alias[col];
+}
+
+static void S3Random_alias_free(S3Random_alias_t *table) {
+  free(table->prob);
+  free(table->alias);
+  memset(table, 0, sizeof(S3Random_alias_t));
+}
+
+// log1p(x) / x and expm1(x) / x, with their Taylor series near 0
+static double S3Random_zipf_helper1(const double x) {
+  if (fabs(x) > 1e-8) {
+    return log1p(x) / x;
+  }
+  return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double S3Random_zipf_helper2(const double x) {
+  if (fabs(x) > 1e-8) {
+    return expm1(x) / x;
+  }
+  return 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static double S3Random_zipf_h(const S3Random_zipf_t *zipf, const double x) {
+  return exp(-zipf->alpha * log(x));
+}
+
+static double S3Random_zipf_h_integral(const S3Random_zipf_t *zipf,
+                                       const double x) {
+  double log_x = log(x);
+  return S3Random_zipf_helper2((1 - zipf->alpha) * log_x) * log_x;
+}
+
+static double S3Random_zipf_h_integral_inv(const S3Random_zipf_t *zipf,
+                                           const double x) {
+  double t = x * (1 - zipf->alpha);
+  if (t < -1) {
+    t = -1;
+  }
+  return exp(S3Random_zipf_helper1(t) * x);
+}
+
+static void S3Random_zipf_init(S3Random_zipf_t *zipf, const double alpha,
+                               const int64_t n) {
+  zipf->alpha = alpha;
+  zipf->n = n;
+  zipf->h_x1 = S3Random_zipf_h_integral(zipf, 1.5) - 1;
+  zipf->h_n = S3Random_zipf_h_integral(zipf, (double)n + 0.5);
+  zipf->s = 2 - S3Random_zipf_h_integral_inv(
+                    zipf, S3Random_zipf_h_integral(zipf, 2.5) -
+                              S3Random_zipf_h(zipf, 2));
+}
+
+/**
+ * @brief a rank in [1, n]
+ */
+static int64_t S3Random_zipf_next(const S3Random_zipf_t *zipf,
+                                  S3Random_rng_t *rng) {
+  while (true) {
+    double u = zipf->h_n + S3Random_uniform(rng) * (zipf->h_x1 - zipf->h_n);
+    double x = S3Random_zipf_h_integral_inv(zipf, u);
+    int64_t k = (int64_t)(x + 0.5);
+    k = MAX(k, 1);
+    k = MIN(k, zipf->n);
+    if (k - x <= zipf->s ||
+        u >= S3Random_zipf_h_integral(zipf, k + 0.5) -
+                 S3Random_zipf_h(zipf, (double)k)) {
+      return k;
+    }
+  }
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                      workload description                     ****
+// ****                                                               ****
+// ***********************************************************************
+
+static void S3Random_workload_parse_size(S3Random_workload_spec_t *spec,
+                                         char *value) {
+  spec->n_size = 0;
+  while (value != NULL && value[0] != '\0') {
+    char *v = strsep(&value, ":");
+    if (spec->n_size == S3RANDOM_WORKLOAD_MAX_SIZE) {
+      ERROR("S3Random workload has more than %d sizes\n",
+            S3RANDOM_WORKLOAD_MAX_SIZE);
+      exit(1);
+    }
+    char *size = strsep(&v, "@");
+    spec->size[spec->n_size] = strtoll(size, NULL, 10);
+    spec->size_weight[spec->n_size] = v == NULL ? 1.0 : strtod(v, NULL);
+    if (spec->size[spec->n_size] <= 0 || spec->size_weight[spec->n_size] <= 0) {
+      ERROR("S3Random workload size %s needs a size and a weight > 0\n", size);
+      exit(1);
+    }
+    spec->n_size += 1;
+  }
+}
+
+static void S3Random_workload_check_ratio(const char *key,
+                                          const double ratio) {
+  if (ratio < 0 || ratio > 1) {
+    ERROR("S3Random workload %s must be in [0, 1]\n", key);
+    exit(1);
+  }
+}
+
+void S3Random_workload_parse(S3Random_workload_spec_t *spec,
+                             const char *workload_str) {
+  memset(spec, 0, sizeof(S3Random_workload_spec_t));
+  spec->seed = S3RANDOM_DEFAULT_SEED;
+  spec->n_obj = 1000000;
+  spec->alpha = 1.0;
+  spec->zipf_method = S3RANDOM_ZIPF_AUTO;
+  spec->scan_len = 1000;
+  spec->shift_ratio = 0.1;
+  spec->size[0] = 1;
+  spec->size_weight[0] = 1;
+  spec->n_size = 1;
+  spec->req_per_sec = 1000;
+
+  char *params_str = strdup(workload_str);
+  char *old_params_str = params_str;
+
+  while (params_str != NULL && params_str[0] != '\0') {
+    /* different parameters are separated by comma,
+     * key and value are separated by = */
+    char *key = strsep((char **)&params_str, "=");
+    char *value = strsep((char **)&params_str, ",");
+
+    // skip the white space
+    while (params_str != NULL && *params_str == ' ') {
+      params_str++;
+    }
+
+    if (value == NULL) {
+      ERROR("S3Random workload %s has no value\n", key);
+      exit(1);
+    } else if (strcasecmp(key, "seed") == 0) {
+      spec->seed = strtoull(value, NULL, 0);
+    } else if (strcasecmp(key, "n-obj") == 0) {
+      spec->n_obj = strtoll(value, NULL, 10);
+    } else if (strcasecmp(key, "alpha") == 0) {
+      spec->alpha = strtod(value, NULL);
+    } else if (strcasecmp(key, "zipf-method") == 0) {
+      if (strcasecmp(value, "auto") == 0) {
+        spec->zipf_method = S3RANDOM_ZIPF_AUTO;
+      } else if (strcasecmp(value, "alias") == 0) {
+        spec->zipf_method = S3RANDOM_ZIPF_ALIAS;
+      } else if (strcasecmp(value, "rejection") == 0) {
+        spec->zipf_method = S3RANDOM_ZIPF_REJECTION;
+      } else {
+        ERROR("S3Random workload zipf-method must be auto, alias or "
+              "rejection\n");
+        exit(1);
+      }
+    } else if (strcasecmp(key, "one-hit-ratio") == 0) {
+      spec->one_hit_ratio = strtod(value, NULL);
+      S3Random_workload_check_ratio(key, spec->one_hit_ratio);
+    } else if (strcasecmp(key, "loop-ratio") == 0) {
+      spec->loop_ratio = strtod(value, NULL);
+      S3Random_workload_check_ratio(key, spec->loop_ratio);
+    } else if (strcasecmp(key, "loop-n-obj") == 0) {
+      spec->loop_n_obj = strtoll(value, NULL, 10);
+    } else if (strcasecmp(key, "scan-ratio") == 0) {
+      spec->scan_ratio = strtod(value, NULL);
+      S3Random_workload_check_ratio(key, spec->scan_ratio);
+    } else if (strcasecmp(key, "scan-n-obj") == 0) {
+      spec->scan_n_obj = strtoll(value, NULL, 10);
+    } else if (strcasecmp(key, "scan-len") == 0) {
+      spec->scan_len = strtoll(value, NULL, 10);
+    } else if (strcasecmp(key, "shift-every") == 0) {
+      spec->shift_every = strtoll(value, NULL, 10);
+    } else if (strcasecmp(key, "shift-ratio") == 0) {
+      spec->shift_ratio = strtod(value, NULL);
+      S3Random_workload_check_ratio(key, spec->shift_ratio);
+    } else if (strcasecmp(key, "size") == 0) {
+      S3Random_workload_parse_size(spec, value);
+    } else if (strcasecmp(key, "req-per-sec") == 0) {
+      spec->req_per_sec = strtoll(value, NULL, 10);
+    } else {
+      ERROR("S3Random workload does not have parameter %s\n", key);
+      exit(1);
+    }
+  }
+  free(old_params_str);
+
+  if (spec->n_obj <= 0 || spec->alpha < 0) {
+    ERROR("S3Random workload needs n-obj > 0 and alpha >= 0\n");
+    exit(1);
+  }
+  if (spec->one_hit_ratio + spec->loop_ratio + spec->scan_ratio > 1) {
+    ERROR("S3Random workload one-hit, loop and scan ratios sum to more "
+          "than 1\n");
+    exit(1);
+  }
+  if (spec->scan_len <= 0 || spec->req_per_sec <= 0 || spec->shift_every < 0) {
+    ERROR("S3Random workload needs scan-len > 0, req-per-sec > 0 and "
+          "shift-every >= 0\n");
+    exit(1);
+  }
+  if (spec->n_size == 0) {
+    ERROR("S3Random workload needs at least one size\n");
+    exit(1);
+  }
+  //the loop and the scan default to the number of popular keys and 10x
+  if (spec->loop_n_obj <= 0) {
+    spec->loop_n_obj = spec->n_obj;
+  }
+  if (spec->scan_n_obj <= 0) {
+    spec->scan_n_obj = 10 * spec->n_obj;
+  }
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                           generation                          ****
+// ****                                                               ****
+// ***********************************************************************
+
+S3Random_workload_t *S3Random_workload_create(
+    const S3Random_workload_spec_t *spec) {
+  S3Random_workload_t *workload = malloc(sizeof(S3Random_workload_t));
+  memset(workload, 0, sizeof(S3Random_workload_t));
+  workload->spec = *spec;
+  S3Random_rng_seed(&workload->rng, spec->seed);
+
+  //the popular keys may not be requested at all
+  bool popular =
+      spec->one_hit_ratio + spec->loop_ratio + spec->scan_ratio < 1;
+  if (spec->alpha > 0 && popular) {
+    bool alias = spec->zipf_method == S3RANDOM_ZIPF_ALIAS ||
+                 (spec->zipf_method == S3RANDOM_ZIPF_AUTO &&
+                  spec->n_obj <= S3RANDOM_WORKLOAD_ALIAS_MAX);
+    if (alias && spec->n_obj > UINT32_MAX) {
+      ERROR("S3Random workload alias table is limited to %u keys\n",
+            UINT32_MAX);
+      exit(1);
+    }
+    if (alias) {
+      double *weight = malloc(sizeof(double) * spec->n_obj);
+      for (int64_t i = 0; i < spec->n_obj; i++) {
+        weight[i] = pow((double)(i + 1), -spec->alpha);
+      }
+      S3Random_alias_init(&workload->rank_alias, weight,
+                          (uint32_t)spec->n_obj);
+      free(weight);
+    } else {
+      S3Random_zipf_init(&workload->zipf, spec->alpha, spec->n_obj);
+    }
+  }
+  S3Random_alias_init(&workload->size_alias, spec->size_weight,
+                      (uint32_t)spec->n_size);
+
+  //a scan is started with a probability such that scan_ratio of the
+  //requests are in a scan of scan_len requests
+  double f = spec->scan_ratio;
+  double l = (double)spec->scan_len;
+  workload->scan_start_prob = f / (l * (1 - f) + f);
+  if (f < 1) {
+    workload->one_hit_prob = spec->one_hit_ratio / (1 - f);
+    workload->loop_prob = spec->loop_ratio / (1 - f);
+  }
+  return workload;
+}
+
+/**
+ * @brief the rank of the next popular key, from 1
+ */
+static inline int64_t S3Random_workload_rank(S3Random_workload_t *workload) {
+  if (workload->spec.alpha == 0) {
+    return 1 + (int64_t)S3Random_rng_bounded(&workload->rng,
+                                             (uint64_t)workload->spec.n_obj);
+  } else if (workload->rank_alias.n > 0) {
+    return 1 + S3Random_alias_draw(&workload->rank_alias,
+                                   S3Random_rng_next(&workload->rng));
+  }
+  return S3Random_zipf_next(&workload->zipf, &workload->rng);
+}
+
+void S3Random_workload_next_batch(S3Random_workload_t *workload,
+                                  request_t *reqs, const int n) {
+  const S3Random_workload_spec_t *spec = &workload->spec;
+  for (int i = 0; i < n; i++) {
+    S3Random_workload_part_e part;
+    int64_t idx;
+    if (workload->scan_left == 0 && spec->scan_ratio > 0 &&
+        S3Random_uniform(&workload->rng) < workload->scan_start_prob) {
+      workload->scan_left = spec->scan_len;
+      workload->scan_pos = (int64_t)S3Random_rng_bounded(
+          &workload->rng, (uint64_t)spec->scan_n_obj);
+    }
+
+    if (workload->scan_left > 0) {
+      part = S3RANDOM_WORKLOAD_SCAN;
+      idx = workload->scan_pos++ % spec->scan_n_obj;
+      workload->scan_left -= 1;
+    } else {
+      double u = workload->one_hit_prob + workload->loop_prob > 0
+                     ? S3Random_uniform(&workload->rng)
+                     : 1;
+      if (u < workload->one_hit_prob) {
+        part = S3RANDOM_WORKLOAD_ONE_HIT;
+        idx = workload->next_one_hit++;
+      } else if (u < workload->one_hit_prob + workload->loop_prob) {
+        part = S3RANDOM_WORKLOAD_LOOP;
+        idx = workload->loop_pos++ % spec->loop_n_obj;
+      } else {
+        part = S3RANDOM_WORKLOAD_POPULAR;
+        idx = S3Random_workload_rank(workload) - 1 + workload->shift_offset;
+      }
+    }
+
+    //the key is a bijection of (part, idx) that spreads the keys over the
+    //whole id space, the size is a hash of the key
+    uint64_t key = ((uint64_t)part << 56 | (uint64_t)(idx + 1)) *
+                   0x9e3779b97f4a7c15ULL;
+    uint64_t h = key ^ spec->seed;
+    reqs[i].obj_id = (obj_id_t)key;
+    reqs[i].obj_size = spec->size[S3Random_alias_draw(&workload->size_alias,
+                                                      S3Random_splitmix64(&h))];
+    reqs[i].clock_time = workload->n_req / spec->req_per_sec;
+    reqs[i].op = OP_GET;
+    reqs[i].valid = true;
+
+    workload->n_req += 1;
+    if (spec->shift_every > 0 && workload->n_req % spec->shift_every == 0) {
+      workload->shift_offset += (int64_t)(spec->shift_ratio * spec->n_obj);
+    }
+  }
+}
+
+void S3Random_workload_replay(S3Random_workload_t *workload, cache_t *cache,
+                              const int64_t n_req,
+                              S3Random_workload_result_t *result) {
+  memset(result, 0, sizeof(S3Random_workload_result_t));
+  request_t *reqs = calloc(S3RANDOM_WORKLOAD_BATCH_SIZE, sizeof(request_t));
+  for (int64_t done = 0; done < n_req; done += S3RANDOM_WORKLOAD_BATCH_SIZE) {
+    int n = (int)MIN(n_req - done, S3RANDOM_WORKLOAD_BATCH_SIZE);
+    S3Random_workload_next_batch(workload, reqs, n);
+    for (int i = 0; i < n; i++) {
+      bool hit = cache->get(cache, &reqs[i]);
+      result->n_byte += reqs[i].obj_size;
+      if (!hit) {
+        result->n_miss += 1;
+        result->n_miss_byte += reqs[i].obj_size;
+      }
+    }
+    result->n_req += n;
+  }
+  free(reqs);
+}
+
+void S3Random_workload_free(S3Random_workload_t *workload) {
+  S3Random_alias_free(&workload->rank_alias);
+  S3Random_alias_free(&workload->size_alias);
+  free(workload);
+}
+
+#ifdef __cplusplus
+}
+#endif
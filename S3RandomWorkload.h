@@ -0,0 +1,158 @@
+//  synthetic workloads generated in memory and replayed through a cache
+//
+//  the requests are built in batches of request_t and given to cache->get
+//  directly, nothing is written to a file, and the same description with
+//  the same seed always gives the same requests
+//
+//  a workload is a mix of
+//      popular keys   Zipf(alpha) over n-obj keys, uniform when alpha = 0
+//      one-hit        keys that are never requested again
+//      loop           a cycle over loop-n-obj keys
+//      scan           bursts of scan-len sequential keys out of scan-n-obj
+//  the ratios are fractions of all the requests, the popular keys get the
+//  rest, and every shift-every requests the popular keys move by
+//  shift-ratio * n-obj ranks so that part of the working set is replaced
+//
+//  the Zipf ranks come from an alias table (O(1), 8 bytes per key) or by
+//  rejection-inversion (O(1), no memory, a few log/exp per key), auto uses
+//  the table up to S3RANDOM_WORKLOAD_ALIAS_MAX keys
+//  the size of an object is drawn from a discrete distribution with an
+//  alias table, with a hash of the key so that a key always has the same
+//  size, size=64@0.5:4096@0.4:1048576@0.1 means 50% of the objects are 64
+//  bytes, the weights do not have to sum to 1 and default to 1
+//
+//  a workload is described like the parameters of a cache
+//      alpha=1.0,n-obj=1000000,size=64@3:4096,one-hit-ratio=0.1,
+//      scan-ratio=0.2,scan-len=10000,shift-every=1000000,seed=42
+//
+//
+//  S3RandomWorkload.h
+//  libCacheSim
+//
+
+#ifndef S3RANDOM_WORKLOAD_H
+#define S3RANDOM_WORKLOAD_H
+
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomRand.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the most sizes of the size distribution
+#define S3RANDOM_WORKLOAD_MAX_SIZE 16
+// the most keys whose Zipf ranks are drawn from an alias table in auto
+#define S3RANDOM_WORKLOAD_ALIAS_MAX (1 << 20)
+// requests generated at once by S3Random_workload_replay
+#define S3RANDOM_WORKLOAD_BATCH_SIZE 4096
+
+typedef enum {
+  S3RANDOM_ZIPF_AUTO = 0,
+  S3RANDOM_ZIPF_ALIAS = 1,
+  S3RANDOM_ZIPF_REJECTION = 2,
+} S3Random_zipf_method_e;
+
+typedef struct {
+  uint64_t seed;
+  int64_t n_obj;
+  double alpha;
+  S3Random_zipf_method_e zipf_method;
+
+  double one_hit_ratio;
+  double loop_ratio;
+  int64_t loop_n_obj;
+  double scan_ratio;
+  int64_t scan_n_obj;
+  int64_t scan_len;
+
+  // 0 never shifts
+  int64_t shift_every;
+  double shift_ratio;
+
+  int64_t size[S3RANDOM_WORKLOAD_MAX_SIZE];
+  double size_weight[S3RANDOM_WORKLOAD_MAX_SIZE];
+  int n_size;
+
+  // the clock_time of the requests advances by 1 every req-per-sec requests
+  int64_t req_per_sec;
+} S3Random_workload_spec_t;
+
+// Walker's alias table, a draw is one random number and one or two reads
+typedef struct {
+  // the probability to keep the column, scaled to 2^32
+  uint32_t *prob;
+  uint32_t *alias;
+  uint32_t n;
+} S3Random_alias_t;
+
+// Zipf over [1, n] by rejection-inversion (Hormann and Derflinger)
+typedef struct {
+  double alpha;
+  int64_t n;
+  double h_x1;
+  double h_n;
+  double s;
+} S3Random_zipf_t;
+
+typedef struct {
+  S3Random_workload_spec_t spec;
+  S3Random_rng_t rng;
+  S3Random_zipf_t zipf;
+  // the Zipf ranks, n is 0 when they are drawn by rejection-inversion
+  S3Random_alias_t rank_alias;
+  S3Random_alias_t size_alias;
+
+  // the probability that a request which is not in a scan starts one, and
+  // the probabilities of the one-hit and loop keys among the requests that
+  // are not in a scan
+  double scan_start_prob;
+  double one_hit_prob;
+  double loop_prob;
+
+  int64_t n_req;
+  int64_t scan_left;
+  int64_t scan_pos;
+  int64_t loop_pos;
+  int64_t next_one_hit;
+  int64_t shift_offset;
+} S3Random_workload_t;
+
+typedef struct {
+  int64_t n_req;
+  int64_t n_miss;
+  int64_t n_byte;
+  int64_t n_miss_byte;
+} S3Random_workload_result_t;
+
+/**
+ * @brief parse a workload description, what is not given keeps its
+ * default, one million keys with Zipf 1.0 and objects of size 1
+ */
+void S3Random_workload_parse(S3Random_workload_spec_t *spec,
+                             const char *workload_str);
+
+S3Random_workload_t *S3Random_workload_create(
+    const S3Random_workload_spec_t *spec);
+
+/**
+ * @brief generate the next n requests, the fields that are not generated
+ * are left as they are
+ */
+void S3Random_workload_next_batch(S3Random_workload_t *workload,
+                                  request_t *reqs, const int n);
+
+/**
+ * @brief generate n_req requests and give them to the cache
+ */
+void S3Random_workload_replay(S3Random_workload_t *workload, cache_t *cache,
+                              const int64_t n_req,
+                              S3Random_workload_result_t *result);
+
+void S3Random_workload_free(S3Random_workload_t *workload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // S3RANDOM_WORKLOAD_H
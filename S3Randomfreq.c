@@ -10,6 +10,10 @@
 //          reinsert to main random
 //      else
 //          evict
+//  an object too large for small is admitted straight to main
+//  with warmup=<n> or warmup-sec=<s> the first requests are served by a
+//  fast get and the counters are reset after them, see S3RandomWarmup.h
+//  evict frees all the bytes the request needs in one call
 //
 //
 //  S3Random.c
@@ -21,29 +25,58 @@
 
 #include "../../dataStructure/hashtable/hashtable.h"
 #include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomIndex.h"
+#include "S3RandomGhost.h"
+#include "S3RandomSample.h"
+#include "S3RandomAdapt.h"
+#include "S3RandomStats.h"
+#include "S3RandomLatency.h"
+#include "S3RandomBatch.h"
+#include "S3RandomSnapshot.h"
+#include "S3RandomWarmup.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+//number of log2 buckets of the histograms of iterations per eviction
 typedef struct {
-  cache_t *small_random;
-  cache_t *ghost_random;
-  cache_t *main_random;
+  // one index for the three queues, each entry is tagged with its queue
+  S3Random_index_t index;
+  S3Random_queue_t small_random;
+  S3Random_ghost_t ghost_random;
+  S3Random_queue_t main_random;
   bool hit_on_ghost;
+  // the small queue gets this fraction of the cache size
+  double small_size_ratio;
+  // the ghost remembers this fraction of the objects in the cache
+  double ghost_size_ratio;
+  // moves the split between small and main when adaptive=1
+  S3Random_adapt_t adapt;
+  // seeds the random generators of the queues and the ghost
+  uint64_t seed;
+  // a counting Bloom filter answers most ghost misses, ghost-filter=1
+  bool ghost_filter;
+  // the index and the queues are mapped on huge pages, hugepage=1
+  bool hugepage;
+  // the first requests take the fast get, warmup=<n> or warmup-sec=<s>
+  S3Random_warmup_t warmup;
   int threshold;
 
-
-  int64_t n_obj_admit_to_small;
-  int64_t n_obj_admit_to_main;
-  int64_t n_obj_move_to_main;
-  int64_t n_byte_admit_to_small;
-  int64_t n_byte_admit_to_main;
-  int64_t n_byte_move_to_main;
+  // candidates sampled in each round of eviction
+  int n_sample;
+  // give up the second chances after this many rounds and evict the
+  // candidate with the lowest frequency, 0 means no bound
+  int max_round;
+  // counters of the internals, read with S3Random_stats_get, with the
+  // histograms of the candidates looked at per eviction
+  S3Random_stats_t stats;
 
   char main_cache_type[32];
-
-  request_t *req_local;
+#ifdef S3RANDOM_LATENCY
+  // durations of the operations, see S3RandomLatency.h
+  S3Random_latency_t latency;
+#endif
 } S3Randomfreq_params_t;
 
 
@@ -57,21 +90,44 @@ cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
                      const char *cache_specific_params);
 static void S3Randomfreq_free(cache_t *cache);
 static bool S3Randomfreq_get(cache_t *cache, const request_t *req);
+static bool S3Randomfreq_get_warmup(cache_t *cache, const request_t *req);
 
 static cache_obj_t *S3Randomfreq_find(cache_t *cache, const request_t *req,
                                 const bool update_cache);
 static cache_obj_t *S3Randomfreq_insert(cache_t *cache, const request_t *req);
+static cache_obj_t *S3Randomfreq_find_warmup(cache_t *cache, const request_t *req,
+                                             const bool update_cache);
+static cache_obj_t *S3Randomfreq_insert_warmup(cache_t *cache,
+                                               const request_t *req);
+#ifdef S3RANDOM_LATENCY
+static cache_obj_t *S3Randomfreq_find_timed(cache_t *cache, const request_t *req,
+                                const bool update_cache);
+static cache_obj_t *S3Randomfreq_insert_timed(cache_t *cache, const request_t *req);
+#endif
 static cache_obj_t *S3Randomfreq_to_evict(cache_t *cache, const request_t *req);
 static void S3Randomfreq_evict(cache_t *cache, const request_t *req);
+static void S3Randomfreq_evict_warmup(cache_t *cache, const request_t *req);
 static bool S3Randomfreq_remove(cache_t *cache, const obj_id_t obj_id);
 static inline int64_t S3Randomfreq_get_occupied_byte(const cache_t *cache);
 static inline int64_t S3Randomfreq_get_n_obj(const cache_t *cache);
 static inline bool S3Randomfreq_can_insert(cache_t *cache, const request_t *req);
+void S3Randomfreq_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+void S3Randomfreq_get_state(cache_t *cache, S3Random_state_t *state);
+void S3Randomfreq_end_warmup(cache_t *cache);
+void S3Randomfreq_get_batch(cache_t *cache, const request_t *reqs, const int n,
+                            bool *hits);
+int64_t S3Randomfreq_evict_bytes(cache_t *cache, const request_t *req,
+                                 const int64_t n_byte);
 static void S3Randomfreq_parse_params(cache_t *cache,
                                 const char *cache_specific_params);
 
-static void S3Randomfreq_evict_small(cache_t *cache, const request_t *req);
-static void S3Randomfreq_evict_main(cache_t *cache, const request_t *req);
+static inline S3RANDOM_WARM_INLINE int64_t S3Randomfreq_evict_small(
+    cache_t *cache, const request_t *req, const bool warm);
+static inline S3RANDOM_WARM_INLINE int64_t S3Randomfreq_evict_main(
+    cache_t *cache, const request_t *req, const bool warm);
+static void S3Randomfreq_insert_ghost(cache_t *cache, S3Random_entry_t *entry);
+static inline void S3Randomfreq_record_iter(int64_t *hist, int64_t *max_iter,
+                                            int64_t n_iter);
 
 // ***********************************************************************
 // ****                                                               ****
@@ -96,9 +152,18 @@ cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
     cache->to_evict = S3Randomfreq_to_evict;
     cache->get_n_obj = S3Randomfreq_get_n_obj;
     cache->get_occupied_byte = S3Randomfreq_get_occupied_byte;
-    cache->can_insert = S3Randomfreq_can_insert;    
-
-    cache->obj_md_size = 0; 
+    cache->can_insert = S3Randomfreq_can_insert;
+#ifdef S3RANDOM_LATENCY
+    cache->find = S3Randomfreq_find_timed;
+    cache->insert = S3Randomfreq_insert_timed;
+#endif    
+
+    //the packed metadata of an object, see S3RANDOM_OBJ_MD_SIZE
+    if (ccache_params.consider_obj_metadata) {
+        cache->obj_md_size = S3RANDOM_OBJ_MD_SIZE;
+    } else {
+        cache->obj_md_size = 0;
+    }
 
 
     //We obtain the parameters to later create the size of the cache
@@ -106,32 +171,48 @@ cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
     memset(cache->eviction_params, 0, sizeof(S3Randomfreq_params_t));
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
 
-    params->req_local = new_request();
     params->hit_on_ghost = false;   
+    //10% of the cache for small and a ghost of 90% of the objects
+    params->small_size_ratio=0.1;
+    params->ghost_size_ratio=0.9;
+    //the split is fixed unless adaptive=1
+    S3Random_adapt_init(&params->adapt, false, ccache_params.cache_size);
+    params->seed=S3RANDOM_DEFAULT_SEED;
     params->threshold=2;//2 bit counter
+    //one candidate per round and no bound is the original eviction
+    params->n_sample=1;
+    params->max_round=0;
     //We parse the parameters 
+    if (cache_specific_params != NULL) {
+        S3Randomfreq_parse_params(cache, cache_specific_params);
+    }
 
     //We calculate the size of the caches
     //small size
     int64_t small_size =
-        (int64_t)ccache_params.cache_size * 0.1;
+        (int64_t)(ccache_params.cache_size * params->small_size_ratio);
     //main size
     int64_t main_cache_size = ccache_params.cache_size - small_size;
-    //ghost size
-    int64_t ghost_cache_size =
-        (int64_t)(ccache_params.cache_size * 0.9); 
-
-    //we create the caches
-    common_cache_params_t local_cache_param = ccache_params;
-    local_cache_param.cache_size = small_size;
-    //create small cache
-    params->small_random = Random_init(local_cache_param, NULL);   
-    //create ghost cache
-    local_cache_param.cache_size= ghost_cache_size;
-    params->ghost_random=Random_init(local_cache_param,NULL);
-    //create main cache
-    local_cache_param.cache_size = main_cache_size;
-    params->main_random=Random_init(local_cache_param,NULL);
+    //ghost size, the ghost counts entries instead of bytes so it is
+    //allocated the first time the cache is full (see insert_ghost)
+
+    //we create the index shared by the three queues
+    S3Random_index_init(&params->index, ccache_params.hashpower,
+                        cache->obj_md_size, params->hugepage, false);
+    //create small queue
+    S3Random_queue_init(&params->small_random, &params->index, S3RANDOM_SMALL, small_size,
+                        params->seed);
+    //create main queue
+    S3Random_queue_init(&params->main_random, &params->index, S3RANDOM_MAIN, main_cache_size,
+                        params->seed);
+
+    //the first requests skip the instrumented get
+    if (S3Random_warmup_enabled(&params->warmup)) {
+        cache->get = S3Randomfreq_get_warmup;
+        cache->find = S3Randomfreq_find_warmup;
+        cache->insert = S3Randomfreq_insert_warmup;
+        cache->evict = S3Randomfreq_evict_warmup;
+    }
 
     //We return cache
     return cache;
@@ -145,16 +226,30 @@ cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
 static void S3Randomfreq_free(cache_t *cache) {
     
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We free the request
-    free_request(params->req_local);
-
-    //we free the != caches used by S3Random
+    //we free the != queues used by S3Random
     //free small
-    params->small_random->cache_free(params->small_random);
+    S3Random_queue_free(&params->small_random);
     //free the ghost
-    params->ghost_random->cache_free(params->ghost_random);
+    DEBUG("%s ghost uses %ld bytes for %ld entries, false positive rate %.3e\n",
+          cache->cache_name, (long)S3Random_ghost_memory(&params->ghost_random),
+          (long)params->ghost_random.n_entry,
+          S3Random_ghost_fp_rate(&params->ghost_random));
+    DEBUG("%s ghost filter uses %ld bytes, false positive rate %.3e\n",
+          cache->cache_name,
+          (long)S3Random_ghost_filter_memory(&params->ghost_random),
+          S3Random_ghost_filter_fp_rate(&params->ghost_random));
+    S3Random_ghost_free(&params->ghost_random);
+    DEBUG("%s small ends at %ld bytes after %ld rebalances\n",
+          cache->cache_name, (long)params->small_random.cache_size,
+          (long)params->adapt.n_rebalance);
+    DEBUG("%s looked at up to %ld candidates per main eviction and %ld per small eviction\n",
+          cache->cache_name, (long)params->stats.max_evict_main_iter,
+          (long)params->stats.max_evict_small_iter);
     //main
-    params->main_random->cache_free(params->main_random);
+    S3Random_queue_free(&params->main_random);
+    //the index owns the objects
+    S3Random_index_free(&params->index);
+    S3RANDOM_LAT_PRINT(&params->latency, cache->cache_name);
 
     //We free the eviction parameters
     free(cache->eviction_params);
@@ -185,19 +280,85 @@ static bool S3Randomfreq_get(cache_t *cache, const request_t *req) {
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
 
 
-    DEBUG_ASSERT(params->small_random->get_occupied_byte(params->small_random)
-                    +params->main_random->get_occupied_byte(params->main_random)
+    DEBUG_ASSERT(params->small_random.occupied_byte
+                    +params->main_random.occupied_byte
                         <= 
                     cache->cache_size);
         
 
+    S3RANDOM_LAT_START(start);
     bool cache_hit = cache_get_base(cache, req);
+    S3RANDOM_LAT_RECORD(&params->latency, S3RANDOM_LAT_GET, start);
 
 
 
     return cache_hit;
 }
 
+/**
+ * @brief get during the warmup, the logic of cache_get_base with the
+ * functions of the cache called directly and without the latency of get,
+ * warmup versions of find, insert and evict that do not count anything, the
+ * state of the cache is the same as with get
+ *
+ * @param cache
+ * @param req
+ * @return true if cache hit, false if cache miss
+ */
+static bool S3Randomfreq_get_warmup(cache_t *cache, const request_t *req) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+
+    cache->n_req += 1;
+    bool cache_hit = S3Randomfreq_find_warmup(cache, req, true) != NULL;
+    if (!cache_hit && S3Randomfreq_can_insert(cache, req)) {
+        //evict frees all the bytes the request needs in one call
+        while (S3Randomfreq_get_occupied_byte(cache) + req->obj_size +
+                   cache->obj_md_size > cache->cache_size) {
+            S3Randomfreq_evict_warmup(cache, req);
+        }
+        S3Randomfreq_insert_warmup(cache, req);
+    }
+
+    if (S3Random_warmup_tick(&params->warmup)) {
+        S3Randomfreq_end_warmup(cache);
+    }
+    return cache_hit;
+}
+
+/**
+ * @brief reset the counters at the end of the warmup and put the normal
+ * get, find, insert and evict back, S3Randomsharded calls it to end the
+ * warmup of its shards
+ */
+void S3Randomfreq_end_warmup(cache_t *cache) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+
+    S3Random_warmup_reset(cache, &params->stats, &params->ghost_random,
+                          &params->adapt);
+    S3RANDOM_LAT_RESET(&params->latency);
+    cache->get = S3Randomfreq_get;
+    cache->find = S3Randomfreq_find;
+    cache->insert = S3Randomfreq_insert;
+    cache->evict = S3Randomfreq_evict;
+#ifdef S3RANDOM_LATENCY
+    cache->find = S3Randomfreq_find_timed;
+    cache->insert = S3Randomfreq_insert_timed;
+#endif
+}
+
+/**
+ * @brief get on n requests, with the buckets of the next requests
+ * prefetched, the hits are the same as calling get on each request
+ *
+ * @param hits hits[i] is the result of reqs[i]
+ */
+void S3Randomfreq_get_batch(cache_t *cache, const request_t *reqs, const int n,
+                            bool *hits) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    S3Random_get_batch_prefetch(cache, &params->index, &params->ghost_random,
+                                reqs, n, hits);
+}
+
 // ***********************************************************************
 // ****                                                               ****
 // ****       developer facing APIs (used by cache developer)         ****
@@ -211,56 +372,77 @@ static bool S3Randomfreq_get(cache_t *cache, const request_t *req) {
  * @param update_cache whether to update the cache,
  *  if true, the object is promoted
  *  and if the object is expired, it is removed from the cache
+ * @param warm true for the warmup, nothing is counted
  * @return the object or NULL if not found
  */
-static cache_obj_t *S3Randomfreq_find(cache_t *cache, const request_t *req,
-                                const bool update_cache) {
+static inline S3RANDOM_WARM_INLINE cache_obj_t *S3Randomfreq_find_impl(
+    cache_t *cache, const request_t *req, const bool update_cache,
+    const bool warm) {
 
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
     //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-    cache_t *ghost=params->ghost_random;
+    S3Random_ghost_t *ghost = &params->ghost_random;
+
+    //the hash is computed once for the index and the ghost
+    uint64_t hv = S3Random_hash(req->obj_id);
+    //one probe tells us if the object is in small or main
+    S3Random_entry_t *entry = S3Random_index_find(&params->index, req->obj_id, hv);
 
     // if update cache is false, we only check the main and small queues as the ghost doesn't have data
     if (!update_cache) {
-        //on small cache??
-        cache_obj_t *obj= small->find(small,req, false);
-        if (obj != NULL) {
-            return obj;
-        }
-        // on main cache??
-        obj= main->find(main,req,false);
-        if (obj != NULL) {
-            return obj;
-        }
-        //Not found
-        return NULL;
+        return entry == NULL ? NULL : &entry->obj;
+    }
+    //the clock of the request tells which objects have expired
+    params->index.clock_time = req->clock_time;
+    //an expired object is reclaimed and the request is a miss
+    if (entry != NULL && S3Random_entry_expired(&params->index, entry)) {
+        S3Random_queue_reclaim(params->index.queues[entry->md.queue], entry);
+        S3RANDOM_STATS_ADD(params, warm, n_expire_find, 1);
+        entry = NULL;
     }
     /* update cache is true from now */
     //we set the hit on ghost is false
     params->hit_on_ghost = false;
-    //on small cache???
-    cache_obj_t *obj =small->find(small,req,true);
-    if (obj != NULL) {
-        //We promote from small to main cache
-        obj->S3Randomfreq.freq++;
-        return obj;
+    //Not found, on ghost queue???
+    if (entry == NULL) {
+        //It returns true if the element is inside and is removed from ghost
+        if (S3Random_ghost_remove(ghost, hv)) {
+            //We say that is a hit on ghost, but is a miss on the cache
+            //so the cache will try to insert the obj and since hit on ghost is true
+            //it will be inserted to the main cache
+            params->hit_on_ghost = true;
+            S3RANDOM_STATS_ADD(params, warm, n_ghost_hit, 1);
+            //small evicted it too early
+            S3Random_adapt_ghost_hit(&params->adapt, req->obj_size);
+        }
+        return NULL;
     }
-    //on ghost queue???
-    //It returns true if the element is inside and is removed from ghost
-    if (ghost->remove(ghost,req->obj_id)){
-        //We say that is a hit on ghost, but is a miss on the cache
-        //so the cache will try to insert the obj and since hit on ghost is true
-        //it will be inserted to the main cache
-        params->hit_on_ghost = true;
+    //on small or main cache, we increase the 2 bit counter
+    if (entry->md.freq < S3RANDOM_MAX_FREQ) {
+        entry->md.freq++;
     }
-    //on main cache???
-    obj=main->find(main,req,true);
-    if (obj != NULL){
-        obj->S3Randomfreq.freq++;
+    //main kept a promoted object long enough to be hit
+    S3Random_adapt_promoted_hit(&params->adapt, entry);
+    //the hits of each queue
+    if (entry->md.queue == S3RANDOM_SMALL) {
+        S3RANDOM_STATS_ADD(params, warm, n_hit_small, 1);
+    } else {
+        S3RANDOM_STATS_ADD(params, warm, n_hit_main, 1);
     }
-    return obj;
+    return &entry->obj;
+}
+
+static cache_obj_t *S3Randomfreq_find(cache_t *cache, const request_t *req,
+                                      const bool update_cache) {
+    return S3Randomfreq_find_impl(cache, req, update_cache, false);
+}
+
+/**
+ * @brief find during the warmup, nothing is counted
+ */
+static cache_obj_t *S3Randomfreq_find_warmup(cache_t *cache, const request_t *req,
+                                             const bool update_cache) {
+    return S3Randomfreq_find_impl(cache, req, update_cache, true);
 }
 
 /**
@@ -272,46 +454,95 @@ static cache_obj_t *S3Randomfreq_find(cache_t *cache, const request_t *req,
  *
  * @param cache
  * @param req
+ * @param warm true for the warmup, nothing is counted
  * @return the inserted object
  */
-static cache_obj_t *S3Randomfreq_insert(cache_t *cache, const request_t *req) {
+static inline S3RANDOM_WARM_INLINE cache_obj_t *S3Randomfreq_insert_impl(
+    cache_t *cache, const request_t *req, const bool warm) {
 
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
     //We define the caches  to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
+    S3Random_queue_t *small= &params->small_random;
+    S3Random_queue_t *main= &params->main_random;
+    S3Random_queue_t *queue = NULL;
 
-    cache_obj_t *obj = NULL;   
     //if before using this function on find there was a hit then we insert it to main
     if (params->hit_on_ghost) {
         //We deselect the hit on ghost
         params->hit_on_ghost = false;
         // update the counters for the simulator
-        params->n_obj_admit_to_main += 1;
-        params->n_byte_admit_to_main += req->obj_size;
+        S3RANDOM_STATS_ADD(params, warm, n_obj_admit_to_main, 1);
+        S3RANDOM_STATS_ADD(params, warm, n_byte_admit_to_main, req->obj_size);
         //we insert it to main
         //If the object is to big for the main cache then we don't insert it
         if (req->obj_size >= main->cache_size) {
             return NULL;
         }
-        obj=main->insert(main,req);
+        queue = main;
     } 
+    //an object too large for small would empty small and still not fit,
+    //it goes straight to main
+    else if (req->obj_size >= small->cache_size) {
+        if (req->obj_size >= main->cache_size) {
+            return NULL;
+        }
+        S3RANDOM_STATS_ADD(params, warm, n_obj_admit_to_main, 1);
+        S3RANDOM_STATS_ADD(params, warm, n_byte_admit_to_main, req->obj_size);
+        S3RANDOM_STATS_ADD(params, warm, n_obj_admit_large, 1);
+        S3RANDOM_STATS_ADD(params, warm, n_byte_admit_large, req->obj_size);
+        queue = main;
+    }
     //else we insert to the small queue
     else {
-      //If the object is to big for the small cache then we don't insert it
-      if (req->obj_size >= small->cache_size) {
-        return NULL;
-      }
       // update the counters for the simulator
-      params->n_obj_admit_to_small += 1;
-      params->n_byte_admit_to_small += req->obj_size;
+      S3RANDOM_STATS_ADD(params, warm, n_obj_admit_to_small, 1);
+      S3RANDOM_STATS_ADD(params, warm, n_byte_admit_to_small, req->obj_size);
 
       //we insert it to the small cache
-      obj= small->insert(small,req);
+      queue = small;
     }
-    obj->S3Randomfreq.freq=0;
+    //the object is hashed once and tagged with the queue it goes to
+    S3Random_entry_t *entry =
+        S3Random_index_insert(&params->index, req, S3Random_hash(req->obj_id));
+    S3Random_queue_push(queue, entry);
+    entry->md.freq=0;
+    return &entry->obj;
+}
+
+static cache_obj_t *S3Randomfreq_insert(cache_t *cache, const request_t *req) {
+    return S3Randomfreq_insert_impl(cache, req, false);
+}
+
+/**
+ * @brief insert during the warmup, nothing is counted
+ */
+static cache_obj_t *S3Randomfreq_insert_warmup(cache_t *cache,
+                                               const request_t *req) {
+    return S3Randomfreq_insert_impl(cache, req, true);
+}
+
+#ifdef S3RANDOM_LATENCY
+/**
+ * @brief find and insert timed into the latency histograms, they replace
+ * find and insert in the cache when S3RANDOM_LATENCY is defined
+ */
+static cache_obj_t *S3Randomfreq_find_timed(cache_t *cache, const request_t *req,
+                                const bool update_cache) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    S3RANDOM_LAT_START(start);
+    cache_obj_t *obj = S3Randomfreq_find(cache, req, update_cache);
+    S3RANDOM_LAT_RECORD(&params->latency, S3RANDOM_LAT_FIND, start);
+    return obj;
+}
+
+static cache_obj_t *S3Randomfreq_insert_timed(cache_t *cache, const request_t *req) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    S3RANDOM_LAT_START(start);
+    cache_obj_t *obj = S3Randomfreq_insert(cache, req);
+    S3RANDOM_LAT_RECORD(&params->latency, S3RANDOM_LAT_INSERT, start);
     return obj;
 }
+#endif
 
 /**
  * @brief find the object to be evicted
@@ -328,96 +559,222 @@ static cache_obj_t *S3Randomfreq_to_evict(cache_t *cache, const request_t *req)
   return NULL;
 }
 
-static void S3Randomfreq_evict_small(cache_t *cache, const request_t *req) {
+static void S3Randomfreq_insert_ghost(cache_t *cache, S3Random_entry_t *entry) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    S3Random_ghost_t *ghost = &params->ghost_random;
+
+    //the ghost counts entries, we size it the first time the cache is full
+    //to remember ghost_size_ratio of the objects the cache holds
+    if (!S3Random_ghost_is_init(ghost)) {
+        int64_t n_obj = params->small_random.n_obj + params->main_random.n_obj + 1;
+        S3Random_ghost_init(ghost, (int64_t)(n_obj * params->ghost_size_ratio),
+                            S3RANDOM_GHOST_FIFO, params->seed,
+                            params->ghost_filter);
+    }
+    //the ghost only keeps a fingerprint of the key, the object is freed
+    S3Random_ghost_insert(ghost, S3Random_hash(entry->obj.obj_id));
+    S3Random_index_remove(&params->index, entry);
+}
+
+static inline void S3Randomfreq_record_iter(int64_t *hist, int64_t *max_iter,
+                                            int64_t n_iter) {
+    //we put the number of iterations in its log2 bucket
+    int bucket = 0;
+    while ((n_iter >> (bucket + 1)) > 0 && bucket < S3RANDOM_STATS_ITER_HIST_SIZE - 1) {
+        bucket++;
+    }
+    hist[bucket] += 1;
+    if (n_iter > *max_iter) {
+        *max_iter = n_iter;
+    }
+}
+
+/**
+ * @brief evict one object of small, the objects that were accessed enough
+ * on the way are moved to main
+ *
+ * @return the bytes freed, 0 when the bound stopped before an eviction
+ */
+static inline S3RANDOM_WARM_INLINE int64_t S3Randomfreq_evict_small(
+    cache_t *cache, const request_t *req, const bool warm) {
 
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
     //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-    cache_t *ghost=params->ghost_random;
+    S3Random_queue_t *small= &params->small_random;
+    S3Random_queue_t *main= &params->main_random;
+    int64_t freed = 0;
+
+    //with a bound we stop after max_round rounds of n_sample candidates
+    int64_t max_iter = (int64_t)params->max_round * params->n_sample;
+    int64_t n_iter = 0;
+
+    //an expired object is reclaimed before a live one is evicted
+    S3Random_entry_t *expired = S3Random_queue_rand_expired(small, S3RANDOM_TTL_N_PROBE);
+    if (expired != NULL) {
+        S3RANDOM_STATS_ADD(params, warm, n_expire_evict, 1);
+        return S3Random_queue_reclaim(small, expired);
+    }
 
     //We evict the small cache only if the occupied bytes is bigger than 0
     bool evicted=false;
-    while (!evicted && small->get_occupied_byte(small) > 0) {
+    while (!evicted && small->occupied_byte > 0) {
+        //we looked at enough candidates, the promotions made room in small
+        //so we stop, the next call will evict from main if main is full
+        if (max_iter > 0 && n_iter >= max_iter) {
+            break;
+        }
+        n_iter += 1;
+
         // evict from small cache
-        cache_obj_t *obj_to_evict =small->to_evict(small,req);
+        S3Random_entry_t *entry_to_evict = S3Random_queue_rand(small);
+        cache_obj_t *obj_to_evict = &entry_to_evict->obj;
 
         //we check that there is no empty obj to be evicted
         DEBUG_ASSERT(obj_to_evict != NULL);
 
-        // need to copy the object before it is evicted so that it can be insert it to main if need it
-        copy_cache_obj_to_request(params->req_local, obj_to_evict);   
-        
         //If object has promoted == true then we promote it to main
-        if (obj_to_evict->S3Randomfreq.freq >= params->threshold) {
+        if (entry_to_evict->md.freq >= params->threshold) {
             // Update statistics
-            params->n_obj_move_to_main += 1;
-            params->n_byte_move_to_main += obj_to_evict->obj_size;
+            S3RANDOM_STATS_ADD(params, warm, n_obj_move_to_main, 1);
+            S3RANDOM_STATS_ADD(params, warm, n_byte_move_to_main, obj_to_evict->obj_size);
 
-            //insert it to main
-            cache_obj_t *new_obj = main->insert(main, params->req_local);
-            new_obj->misc.freq =obj_to_evict->misc.freq;
+            //move it to main, it stays in the index we only flip the tag
+            S3Random_queue_promote(small, main, entry_to_evict);
+            //the counter starts again in main
+            entry_to_evict->md.freq=0;
 
         } 
         // The obj doesn't have promotion activated so we evict it and save the 
         //pointer on the ghost cache
         else {
-            ghost->get(ghost, params->req_local);
+            freed = S3Random_entry_byte(&params->index, entry_to_evict);
+            S3Random_queue_remove(small, entry_to_evict);
+            S3Randomfreq_insert_ghost(cache, entry_to_evict);
+            S3RANDOM_STATS_ADD(params, warm, n_evict_small, 1);
             //we evicted
             evicted=true;
         }
-
-    // remove from small cache, but do not update stat
-    bool removed = small->remove(small, params->req_local->obj_id);
-    assert(removed);
   }
+  //the iterations of the evictions of the warmup are not measured
+  if (!warm) {
+      S3Randomfreq_record_iter(params->stats.evict_small_iter,
+                               &params->stats.max_evict_small_iter, n_iter);
+  }
+  return freed;
 }
 
-static void S3Randomfreq_evict_main(cache_t *cache, const request_t *req) {
+/**
+ * @brief evict one object of main, the sampled objects that were accessed
+ * get a second chance
+ *
+ * @return the bytes freed
+ */
+static inline S3RANDOM_WARM_INLINE int64_t S3Randomfreq_evict_main(
+    cache_t *cache, const request_t *req, const bool warm) {
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
     //We define the caches to avoid redundancy
-    cache_t *main=params->main_random;
+    S3Random_queue_t *main= &params->main_random;
+    int64_t freed = 0;
+
+    S3Random_sample_t sample;
+    int64_t n_iter = 0;
+    int round = 0;
+
+    //an expired object is reclaimed before a live one is evicted
+    S3Random_entry_t *expired = S3Random_queue_rand_expired(main, S3RANDOM_TTL_N_PROBE);
+    if (expired != NULL) {
+        S3RANDOM_STATS_ADD(params, warm, n_expire_evict, 1);
+        return S3Random_queue_reclaim(main, expired);
+    }
 
     // evict from main cache
     //we only evict if the occupied space is bigger than 0
     bool evicted=false;
-    while (!evicted && main->get_occupied_byte(main) > 0) {
-        //we evict from main
-
-        cache_obj_t *obj_to_evict = main->to_evict(main, req);
-        //We check if we evicted the object
-        DEBUG_ASSERT(obj_to_evict != NULL);
-        int freq =obj_to_evict->S3Randomfreq.freq;
-
-
+    while (!evicted && main->occupied_byte > 0) {
+        round += 1;
 
-        //We need to do this to create a request to remove the object from the queue
-        copy_cache_obj_to_request(params->req_local, obj_to_evict);
+        //we sample the candidates of this round and keep the one
+        //with the lowest frequency, a candidate drawn twice only gets
+        //one second chance
+        S3Random_queue_sample(main, params->n_sample, S3RANDOM_SCORE_FREQ, &sample);
+        n_iter += params->n_sample;
+        int best = S3Random_sample_best(&sample);
 
-        if ( freq >0){
-            //main->remove(main,obj_to_evict->obj_id);
-            //obj_to_evict = NULL;
-            obj_to_evict->S3Randomfreq.freq= MIN(freq,3)-1;
-            obj_to_evict->misc.freq=freq;
-            //we don't evict it because its frequency is bigger than 0
-            //and we reinsert it back
-            //cache_obj_t *new_obj = main->insert(main, params->req_local);
-            //2 bit counter
-            //new_obj->S3Randomfreq.freq = MIN(freq,3)-1;
-            //new_obj->misc.freq=freq;
-
-
-        }else{
+        //the best candidate was not accessed or we looked long enough
+        if (sample.score[best] <= 0 ||
+            (params->max_round > 0 && round >= params->max_round)) {
 
             // we remove the object to be evicted 
-            bool removed = main->remove(main, obj_to_evict->obj_id);
-            // if we cannot remove it then we raise a personalized error
-            if (!removed) {
-            ERROR("cannot remove obj %ld\n", (long)obj_to_evict->obj_id);
-            }   
+            S3Random_entry_t *entry_to_evict = S3Random_sample_entry(main, &sample, best);
+            freed = S3Random_entry_byte(&params->index, entry_to_evict);
+            S3Random_queue_remove(main, entry_to_evict);
+            S3Random_index_remove(&params->index, entry_to_evict);
+            S3RANDOM_STATS_ADD(params, warm, n_evict_main, 1);
             evicted=true;
+        }else{
+            //we don't evict them because their frequency is bigger than 0
+            for (int j = 0; j < sample.n; j++) {
+                S3Random_entry_t *entry = S3Random_sample_entry(main, &sample, j);
+                //the 2 bit counter stops at 0
+                if (entry->md.freq > 0) {
+                    entry->md.freq -= 1;
+                    S3RANDOM_STATS_ADD(params, warm, n_second_chance, 1);
+                }
+            }
         }
     }
+    if (!warm) {
+        S3Randomfreq_record_iter(params->stats.evict_main_iter,
+                                 &params->stats.max_evict_main_iter, n_iter);
+    }
+    return freed;
+}
+
+/**
+ * @brief evict objects until n_byte bytes are freed, at least one object
+ * is evicted or moved to main even if n_byte <= 0
+ * the queue is picked for each object as in evict, main when it is over
+ * its size and small otherwise, and main when the request is too large for
+ * small since it will be admitted to main
+ *
+ * @param req the request the room is made for, NULL if there is none
+ * @param warm true for the warmup, nothing is counted
+ * @return the bytes freed, less than n_byte only if the cache is empty
+ */
+static inline S3RANDOM_WARM_INLINE int64_t S3Randomfreq_evict_bytes_impl(
+    cache_t *cache, const request_t *req, const int64_t n_byte,
+    const bool warm) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    //We define the caches to avoid redundancy
+    S3Random_queue_t *small= &params->small_random;
+    S3Random_queue_t *main= &params->main_random;
+    //the split moves lazily, only when the cache evicts
+    S3Random_adapt_rebalance(&params->adapt, small, main);
+    bool to_main = req != NULL && req->obj_size >= small->cache_size;
+
+    int64_t freed = 0;
+    do {
+        if (small->n_obj == 0 && main->n_obj == 0) {
+            break;
+        }
+        S3RANDOM_LAT_START(start);
+        // if the main is full we evict the main cache
+        if (main->occupied_byte > main->cache_size || small->occupied_byte == 0 ||
+            (to_main && main->occupied_byte > 0)) {
+            freed += S3Randomfreq_evict_main(cache, req, warm);
+            S3RANDOM_LAT_RECORD(&params->latency, S3RANDOM_LAT_EVICT_MAIN, start);
+        } else {
+            //else we evict the small cache
+            freed += S3Randomfreq_evict_small(cache, req, warm);
+            S3RANDOM_LAT_RECORD(&params->latency, S3RANDOM_LAT_EVICT_SMALL, start);
+        }
+    } while (freed < n_byte);
+    return freed;
+}
+
+int64_t S3Randomfreq_evict_bytes(cache_t *cache, const request_t *req,
+                                 const int64_t n_byte) {
+    return S3Randomfreq_evict_bytes_impl(cache, req, n_byte, false);
 }
 
 
@@ -427,22 +784,31 @@ static void S3Randomfreq_evict_main(cache_t *cache, const request_t *req) {
  * which updates some metadata such as n_obj, occupied size, and hash table
  *
  * @param cache
- * @param req not used
+ * @param req the request the room is made for
  * @param evicted_obj if not NULL, return the evicted object to caller
+ * @param warm true for the warmup, nothing is counted
  */
-static void S3Randomfreq_evict(cache_t *cache, const request_t *req) {
+static inline S3RANDOM_WARM_INLINE void S3Randomfreq_evict_impl(
+    cache_t *cache, const request_t *req, const bool warm) {
 
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-    cache_t *ghost=params->ghost_random;
-    // if the main is full we evict the main cache
-    if (main->get_occupied_byte(main) > main->cache_size ||small->get_occupied_byte(small) == 0) {
-      return S3Randomfreq_evict_main(cache, req);
-    }
-    //else we evict the small cache
-    return S3Randomfreq_evict_small(cache, req);
+    //one call frees all the bytes the request needs, so the loop of
+    //cache_get_base does not come back once per evicted object
+    int64_t need = params->small_random.occupied_byte +
+                   params->main_random.occupied_byte + req->obj_size +
+                   cache->obj_md_size - cache->cache_size;
+    S3Randomfreq_evict_bytes_impl(cache, req, need, warm);
+}
+
+static void S3Randomfreq_evict(cache_t *cache, const request_t *req) {
+    S3Randomfreq_evict_impl(cache, req, false);
+}
+
+/**
+ * @brief evict during the warmup, nothing is counted
+ */
+static void S3Randomfreq_evict_warmup(cache_t *cache, const request_t *req) {
+    S3Randomfreq_evict_impl(cache, req, true);
 }
 
 /**
@@ -461,46 +827,150 @@ static void S3Randomfreq_evict(cache_t *cache, const request_t *req) {
 static bool S3Randomfreq_remove(cache_t *cache, const obj_id_t obj_id) {
 
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-    cache_t *ghost=params->ghost_random;
 
-    //we remove the objects and if removed successfully it returns a true
-    bool removed = false;
-    removed = removed || small->remove(small,obj_id) 
-                      || ghost->remove(ghost,obj_id)
-                      || main->remove(main,obj_id);  
-    return removed;
+    //one probe finds the object whatever queue it is on
+    uint64_t hv = S3Random_hash(obj_id);
+    S3Random_entry_t *entry = S3Random_index_find(&params->index, obj_id, hv);
+    if (entry == NULL) {
+        //the object may only be remembered by the ghost
+        return S3Random_ghost_remove(&params->ghost_random, hv);
+    }
+    //we remove it from its queue and from the index
+    if (entry->md.queue == S3RANDOM_SMALL) {
+        S3Random_queue_remove(&params->small_random, entry);
+    } else {
+        S3Random_queue_remove(&params->main_random, entry);
+    }
+    S3Random_index_remove(&params->index, entry);
+    return true;
 }
 
 static inline int64_t S3Randomfreq_get_occupied_byte(const cache_t *cache) {
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-
 
-    return small->get_occupied_byte(small)+main->get_occupied_byte(main);
+    return params->small_random.occupied_byte+params->main_random.occupied_byte;
 }
 
 static inline int64_t S3Randomfreq_get_n_obj(const cache_t *cache) {
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    cache_t *main=params->main_random;
-    cache_t *ghost=params->ghost_random;
 
-    return small->get_n_obj(small) +main->get_n_obj(main);
+    return params->small_random.n_obj +params->main_random.n_obj;
 }
 
 
 static inline bool S3Randomfreq_can_insert(cache_t *cache, const request_t *req) {
     S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
-    //We define the caches to avoid redundancy
-    cache_t *small= params->small_random;
-    //we only care if we can insert on small
-    return req->obj_size <= small->cache_size;
+    //an object too large for small is admitted to main
+    return req->obj_size < MAX(params->small_random.cache_size,
+                               params->main_random.cache_size);
+}
+
+/**
+ * @brief the counters of the cache and the occupancy of its queues, see
+ * S3Random_stats_get
+ */
+void S3Randomfreq_get_stats(const cache_t *cache, S3Random_stats_t *stats) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    S3Random_stats_read(stats, &params->stats, cache, &params->small_random,
+                        &params->main_random, &params->ghost_random);
+}
+
+/**
+ * @brief the parts of the cache a snapshot reads and writes, see
+ * S3RandomSnapshot.h
+ */
+void S3Randomfreq_get_state(cache_t *cache, S3Random_state_t *state) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    state->index = &params->index;
+    state->ghost = &params->ghost_random;
+    state->adapt = &params->adapt;
+    state->stats = &params->stats;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                  parameter set up functions                   ****
+// ****                                                               ****
+// ***********************************************************************
+static void S3Randomfreq_parse_params(cache_t *cache,
+                                const char *cache_specific_params) {
+    S3Randomfreq_params_t *params = (S3Randomfreq_params_t *)cache->eviction_params;
+    char *params_str = strdup(cache_specific_params);
+    char *old_params_str = params_str;
+
+    while (params_str != NULL && params_str[0] != '\0') {
+        /* different parameters are separated by comma,
+         * key and value are separated by = */
+        char *key = strsep((char **)&params_str, "=");
+        char *value = strsep((char **)&params_str, ",");
+
+        // skip the white space
+        while (params_str != NULL && *params_str == ' ') {
+            params_str++;
+        }
+
+        if (value == NULL) {
+            ERROR("%s parameter %s has no value\n", cache->cache_name, key);
+            exit(1);
+        } else if (strcasecmp(key, "small-size-ratio") == 0) {
+            params->small_size_ratio = strtod(value, NULL);
+            if (params->small_size_ratio <= 0 || params->small_size_ratio >= 1) {
+                ERROR("%s small-size-ratio must be in (0, 1)\n", cache->cache_name);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "ghost-size-ratio") == 0) {
+            params->ghost_size_ratio = strtod(value, NULL);
+            if (params->ghost_size_ratio <= 0) {
+                ERROR("%s ghost-size-ratio must be > 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "adaptive") == 0) {
+            params->adapt.enabled = atoi(value) != 0;
+        } else if (strcasecmp(key, "seed") == 0) {
+            params->seed = strtoull(value, NULL, 10);
+        } else if (strcasecmp(key, "ghost-filter") == 0) {
+            params->ghost_filter = atoi(value) != 0;
+        } else if (strcasecmp(key, "hugepage") == 0) {
+            params->hugepage = atoi(value) != 0;
+        } else if (strcasecmp(key, "warmup") == 0) {
+            params->warmup.n_req = strtoll(value, NULL, 10);
+            if (params->warmup.n_req < 0) {
+                ERROR("%s warmup must be >= 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "warmup-sec") == 0) {
+            params->warmup.sec = strtod(value, NULL);
+            if (params->warmup.sec < 0) {
+                ERROR("%s warmup-sec must be >= 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "move-to-main-threshold") == 0) {
+            params->threshold = atoi(value);
+            if (params->threshold < 1 || params->threshold > S3RANDOM_MAX_FREQ) {
+                ERROR("%s move-to-main-threshold must be in [1, %d]\n",
+                      cache->cache_name, S3RANDOM_MAX_FREQ);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "n-sample") == 0) {
+            params->n_sample = atoi(value);
+            if (params->n_sample < 1 || params->n_sample > S3RANDOM_MAX_SAMPLE) {
+                ERROR("%s n-sample must be in [1, %d]\n", cache->cache_name,
+                      S3RANDOM_MAX_SAMPLE);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "max-round") == 0) {
+            params->max_round = atoi(value);
+            if (params->max_round < 0) {
+                ERROR("%s max-round must be >= 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else {
+            ERROR("%s does not have parameter %s\n", cache->cache_name, key);
+            exit(1);
+        }
+    }
+
+    free(old_params_str);
 }
 
 #ifdef __cplusplus
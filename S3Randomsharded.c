@@ -0,0 +1,693 @@
+//  thread-safe S3Random made of independent shards
+//  each shard is a whole S3Random, S3Randomtwo or S3Randomfreq cache with
+//  its own small, main and ghost queues and its own scratch state
+//  (hit_on_ghost), a request is routed to one shard by the hash of its key
+//  and only takes the lock of that shard
+//
+//  each shard publishes its occupied bytes and object count after every
+//  request, so the totals of the cache are summed without taking any lock
+//
+//  hits do not take the lock either, a hit adds itself to the readers of
+//  the shard, and goes on only if no writer holds the shard (its sequence
+//  number is even), a writer makes the sequence number odd once it has the
+//  lock and waits until the readers that came before are done, so a hit
+//  never sees an entry a writer is moving and a writer never moves an
+//  entry a hit is updating (the grace period of RCU, with one counter per
+//  shard instead of one per thread), the hit then updates the entry with
+//  relaxed atomics since other hits may update it too
+//      S3Random, S3Randomfreq: a CAS on the packed metadata byte that
+//                              increases the 2-bit counter
+//      S3Randomtwo:            the last access time from the virtual
+//                              clock of the shard (an atomic add shared
+//                              with the get under the lock), and a CAS
+//                              that sets the promoted bit
+//  a miss or a hit that finds a writer takes the lock
+//
+//  parameters
+//      n-shard=16          number of shards, each gets cache_size / n-shard
+//      algo=S3Random       the cache used by each shard
+//      lock-free-hit=1     0 serves the hits under the lock of the shard
+//      seed=<n>            shard i draws its random numbers from seed + i
+//      warmup=<n>          the first n requests are a warmup, see
+//      warmup-sec=<s>      S3RandomWarmup.h, the shards take their fast get
+//                          and the counters of all the shards are reset
+//                          together, under all the locks, when it ends
+//  the other parameters are given to the cache of each shard
+//
+//
+//  S3Randomsharded.c
+//  libCacheSim
+//
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../../dataStructure/hashtable/hashtable.h"
+#include "../../include/libCacheSim/evictionAlgo.h"
+#include "S3RandomIndex.h"
+#include "S3RandomStats.h"
+#include "S3RandomWarmup.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define S3RANDOMSHARDED_MAX_SHARD 1024
+// the longest parameters given to the caches of the shards
+#define S3RANDOMSHARDED_PARAMS_LEN 256
+// what each shard adds to them, ",seed=<20 digits>,warmup=<19 digits>"
+#define S3RANDOMSHARDED_SHARD_PARAMS_EXTRA 64
+
+cache_t *S3Random_init(const common_cache_params_t ccache_params,
+                       const char *cache_specific_params);
+cache_t *S3Randomtwo_init(const common_cache_params_t ccache_params,
+                          const char *cache_specific_params);
+cache_t *S3Randomfreq_init(const common_cache_params_t ccache_params,
+                           const char *cache_specific_params);
+void S3Random_end_warmup(cache_t *cache);
+void S3Randomtwo_end_warmup(cache_t *cache);
+void S3Randomfreq_end_warmup(cache_t *cache);
+
+// one shard per cache line so that the shards do not share lines
+typedef struct {
+  pthread_mutex_t lock;
+  // odd while a writer holds the lock
+  uint64_t seq;
+  // the hits served without the lock that are running, a writer waits for
+  // them before it changes the cache
+  int64_t n_reader;
+  cache_t *cache;
+  // the index of the cache, read by the hits without the lock
+  S3Random_index_t *index;
+  // published after each request, read without the lock
+  int64_t occupied_byte;
+  int64_t n_obj;
+  // the parameters the cache of the shard was created with, the cache keeps
+  // a pointer
+  char cache_params[S3RANDOMSHARDED_PARAMS_LEN +
+                    S3RANDOMSHARDED_SHARD_PARAMS_EXTRA];
+  // hits served without the lock for each queue, the cache of the shard
+  // does not see them, on their own line as every lock-free hit writes them
+  int64_t n_lock_free_hit[S3RANDOM_N_QUEUE] __attribute__((aligned(64)));
+} __attribute__((aligned(64))) S3Randomsharded_shard_t;
+
+typedef struct {
+  S3Randomsharded_shard_t *shards;
+  int n_shard;
+  char algo[32];
+  bool lock_free_hit;
+  // what a hit updates, the frequency or the last access
+  bool hit_updates_freq;
+  // the parameters given to the cache of each shard
+  char shard_params[S3RANDOMSHARDED_PARAMS_LEN];
+  // shard i is seeded with seed + i
+  uint64_t seed;
+  // the warmup of the whole cache, its requests are counted with an atomic
+  // add by every thread until it ends
+  S3Random_warmup_t warmup;
+  bool warming;
+  void (*end_warmup)(cache_t *cache);
+} S3Randomsharded_params_t;
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                   function declarations                       ****
+// ****                                                               ****
+// ***********************************************************************
+cache_t *S3Randomsharded_init(const common_cache_params_t ccache_params,
+                              const char *cache_specific_params);
+static void S3Randomsharded_free(cache_t *cache);
+static bool S3Randomsharded_get(cache_t *cache, const request_t *req);
+
+static cache_obj_t *S3Randomsharded_find(cache_t *cache, const request_t *req,
+                                         const bool update_cache);
+static cache_obj_t *S3Randomsharded_insert(cache_t *cache,
+                                           const request_t *req);
+static cache_obj_t *S3Randomsharded_to_evict(cache_t *cache,
+                                             const request_t *req);
+static void S3Randomsharded_evict(cache_t *cache, const request_t *req);
+static bool S3Randomsharded_remove(cache_t *cache, const obj_id_t obj_id);
+static inline int64_t S3Randomsharded_get_occupied_byte(const cache_t *cache);
+static inline int64_t S3Randomsharded_get_n_obj(const cache_t *cache);
+static inline bool S3Randomsharded_can_insert(cache_t *cache,
+                                              const request_t *req);
+void S3Randomsharded_get_stats(const cache_t *cache, S3Random_stats_t *stats);
+int S3Randomsharded_get_shards(const cache_t *cache, cache_t **shards,
+                               int64_t **n_lock_free_hit);
+void S3Randomsharded_lock_all(cache_t *cache, const bool lock);
+static void S3Randomsharded_parse_params(cache_t *cache,
+                                         const char *cache_specific_params);
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                   end user facing functions                   ****
+// ****                                                               ****
+// ***********************************************************************
+
+cache_t *S3Randomsharded_init(const common_cache_params_t ccache_params,
+                              const char *cache_specific_params) {
+    //We define create the cache structure init
+    cache_t *cache = cache_struct_init("S3Randomsharded", ccache_params,
+                                       cache_specific_params);
+
+    //We define the new functions of the cache with the new structure
+    cache->cache_init = S3Randomsharded_init;
+    cache->cache_free = S3Randomsharded_free;
+    cache->get = S3Randomsharded_get;
+    cache->find = S3Randomsharded_find;
+    cache->insert = S3Randomsharded_insert;
+    cache->evict = S3Randomsharded_evict;
+    cache->remove = S3Randomsharded_remove;
+    cache->to_evict = S3Randomsharded_to_evict;
+    cache->get_n_obj = S3Randomsharded_get_n_obj;
+    cache->get_occupied_byte = S3Randomsharded_get_occupied_byte;
+    cache->can_insert = S3Randomsharded_can_insert;
+
+    cache->obj_md_size = 0;
+
+    cache->eviction_params = malloc(sizeof(S3Randomsharded_params_t));
+    memset(cache->eviction_params, 0, sizeof(S3Randomsharded_params_t));
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+
+    params->n_shard = 16;
+    strncpy(params->algo, "S3Random", sizeof(params->algo) - 1);
+    params->lock_free_hit = true;
+    params->seed = S3RANDOM_DEFAULT_SEED;
+    //We parse the parameters
+    if (cache_specific_params != NULL) {
+        S3Randomsharded_parse_params(cache, cache_specific_params);
+    }
+
+    cache_init_func_ptr init = S3Random_init;
+    params->end_warmup = S3Random_end_warmup;
+    params->hit_updates_freq = true;
+    if (strcasecmp(params->algo, "S3Randomtwo") == 0) {
+        init = S3Randomtwo_init;
+        params->end_warmup = S3Randomtwo_end_warmup;
+        params->hit_updates_freq = false;
+    } else if (strcasecmp(params->algo, "S3Randomfreq") == 0) {
+        init = S3Randomfreq_init;
+        params->end_warmup = S3Randomfreq_end_warmup;
+    }
+    //the shards take their fast get until this cache ends their warmup
+    params->warming = S3Random_warmup_enabled(&params->warmup);
+
+    //every shard gets the same part of the cache and of the hash table
+    common_cache_params_t shard_ccache_params = ccache_params;
+    shard_ccache_params.cache_size = ccache_params.cache_size / params->n_shard;
+    int shard_hashpower = ccache_params.hashpower;
+    for (int n = params->n_shard; n > 1 && shard_hashpower > 10; n /= 2) {
+        shard_hashpower -= 1;
+    }
+    shard_ccache_params.hashpower = shard_hashpower;
+
+    if (posix_memalign((void **)&params->shards, 64,
+                       sizeof(S3Randomsharded_shard_t) * params->n_shard) != 0) {
+        ERROR("cannot allocate %d shards\n", params->n_shard);
+    }
+    memset(params->shards, 0, sizeof(S3Randomsharded_shard_t) * params->n_shard);
+    for (int i = 0; i < params->n_shard; i++) {
+        S3Randomsharded_shard_t *shard = &params->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        //every shard draws its own random stream, a truncated string would
+        //silently drop the seed or the warmup
+        int len = snprintf(shard->cache_params, sizeof(shard->cache_params),
+                           "%s%sseed=%llu%s", params->shard_params,
+                           params->shard_params[0] == '\0' ? "" : ",",
+                           (unsigned long long)(params->seed + (uint64_t)i),
+                           params->warming ? ",warmup=9223372036854775807"
+                                           : "");
+        if (len < 0 || (size_t)len >= sizeof(shard->cache_params)) {
+            ERROR("%s parameters of the shards are too long\n",
+                  cache->cache_name);
+            exit(1);
+        }
+        shard->cache = init(shard_ccache_params, shard->cache_params);
+        //the index is the first member of the params of every variant
+        shard->index = (S3Random_index_t *)shard->cache->eviction_params;
+    }
+    //the objects carry the metadata of the cache of their shard
+    cache->obj_md_size = params->shards[0].cache->obj_md_size;
+
+    //We return cache
+    return cache;
+}
+
+/**
+ * We free the resources the cache is using
+ *
+ * @param cache
+ */
+static void S3Randomsharded_free(cache_t *cache) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    for (int i = 0; i < params->n_shard; i++) {
+        S3Randomsharded_shard_t *shard = &params->shards[i];
+        shard->cache->cache_free(shard->cache);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(params->shards);
+
+    //We free the eviction parameters
+    free(cache->eviction_params);
+    //We free the cache structure
+    cache_struct_free(cache);
+}
+
+/**
+ * @brief the shard of a key, the hash is mixed again so that the shard is
+ * independent of the bucket and fingerprint the shard computes from it
+ */
+static inline S3Randomsharded_shard_t *S3Randomsharded_shard(
+    const S3Randomsharded_params_t *params, const obj_id_t obj_id) {
+    uint64_t hv = S3Random_hash(S3Random_hash(obj_id));
+    return &params->shards[hv % (uint64_t)params->n_shard];
+}
+
+/**
+ * @brief take the lock of a shard before changing it, the sequence number
+ * is odd until S3Randomsharded_unlock, and the hits that started before
+ * are done when it returns
+ */
+static inline void S3Randomsharded_lock(S3Randomsharded_shard_t *shard) {
+    pthread_mutex_lock(&shard->lock);
+    //either a hit sees the odd number, or we see the hit in n_reader
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_SEQ_CST);
+    for (int spin = 0;
+         __atomic_load_n(&shard->n_reader, __ATOMIC_SEQ_CST) != 0; spin++) {
+        //a hit is a few loads, unless its thread was descheduled
+        if (spin >= 64) {
+            sched_yield();
+        }
+    }
+}
+
+static inline void S3Randomsharded_unlock(S3Randomsharded_shard_t *shard) {
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief serve a hit without the lock of the shard
+ *
+ * @return false if the object was not found or a writer holds the shard,
+ * the request then takes the lock
+ */
+static inline bool S3Randomsharded_hit_lock_free(
+    const S3Randomsharded_params_t *params, S3Randomsharded_shard_t *shard,
+    const request_t *req) {
+    __atomic_fetch_add(&shard->n_reader, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shard->seq, __ATOMIC_SEQ_CST) & 1) {
+        __atomic_fetch_sub(&shard->n_reader, 1, __ATOMIC_RELEASE);
+        return false;
+    }
+    //no writer can change the index until we leave
+    S3Random_entry_t *entry = S3Random_index_find(
+        shard->index, req->obj_id, S3Random_hash(req->obj_id));
+    //an expired object is reclaimed by the get under the lock
+    if (entry == NULL || S3Random_entry_expired_at(entry, req->clock_time)) {
+        __atomic_fetch_sub(&shard->n_reader, 1, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    if (!params->hit_updates_freq) {
+        //S3Randomtwo, the get under the lock ticks the same atomic clock
+        int64_t now = S3Random_index_tick(shard->index);
+        if (shard->index->last_access != NULL) {
+            __atomic_store_n(S3Random_index_last_access(shard->index, entry),
+                             now, __ATOMIC_RELAXED);
+        }
+    }
+    //the bit fields share one byte, we change a copy and swap it in
+    S3Random_md_t old_md, new_md;
+    old_md.byte = __atomic_load_n(&entry->md.byte, __ATOMIC_RELAXED);
+    do {
+        new_md = old_md;
+        if (params->hit_updates_freq) {
+            if (old_md.freq == S3RANDOM_MAX_FREQ) {
+                break;
+            }
+            new_md.freq += 1;
+        } else {
+            if (old_md.queue != S3RANDOM_SMALL || old_md.promoted) {
+                break;
+            }
+            new_md.promoted = 1;
+        }
+    } while (!__atomic_compare_exchange_n(&entry->md.byte, &old_md.byte,
+                                          new_md.byte, true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+    __atomic_fetch_add(&shard->n_lock_free_hit[old_md.queue], 1,
+                       __ATOMIC_RELAXED);
+    //the writer that waits for us sees our updates
+    __atomic_fetch_sub(&shard->n_reader, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief publish the totals of a shard, called with its lock held
+ */
+static inline void S3Randomsharded_publish(S3Randomsharded_shard_t *shard) {
+    cache_t *shard_cache = shard->cache;
+    __atomic_store_n(&shard->occupied_byte,
+                     shard_cache->get_occupied_byte(shard_cache),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->n_obj, shard_cache->get_n_obj(shard_cache),
+                     __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief count a request of the warmup, the thread whose request ends it
+ * resets the counters of every shard under all the locks
+ */
+static inline void S3Randomsharded_warmup_tick(cache_t *cache) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    if (!__atomic_load_n(&params->warming, __ATOMIC_RELAXED)) {
+        return;
+    }
+    S3Random_warmup_t *warmup = &params->warmup;
+    int64_t n_done =
+        __atomic_add_fetch(&warmup->n_done, 1, __ATOMIC_RELAXED);
+    bool over = warmup->n_req > 0 && n_done >= warmup->n_req;
+    if (!over && warmup->sec > 0) {
+        double end_time;
+        __atomic_load(&warmup->end_time, &end_time, __ATOMIC_RELAXED);
+        if (end_time == 0) {
+            //the first request starts the clock
+            double now_end = S3Random_warmup_now() + warmup->sec;
+            __atomic_compare_exchange(&warmup->end_time, &end_time, &now_end,
+                                      false, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED);
+        } else if ((n_done & (S3RANDOM_WARMUP_CLOCK_INTERVAL - 1)) == 0) {
+            over = S3Random_warmup_now() >= end_time;
+        }
+    }
+    bool warming = true;
+    if (!over || !__atomic_compare_exchange_n(&params->warming, &warming,
+                                              false, false, __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    S3Randomsharded_lock_all(cache, true);
+    for (int i = 0; i < params->n_shard; i++) {
+        S3Randomsharded_shard_t *shard = &params->shards[i];
+        params->end_warmup(shard->cache);
+        memset(shard->n_lock_free_hit, 0, sizeof(shard->n_lock_free_hit));
+    }
+    S3Randomsharded_lock_all(cache, false);
+}
+
+/**
+ * @brief this function is the user facing API, it can be called from many
+ * threads at the same time
+ * the request is served by the shard of its key, under the lock of the shard
+ *
+ * @param cache
+ * @param req
+ * @return true if cache hit, false if cache miss
+ */
+static bool S3Randomsharded_get(cache_t *cache, const request_t *req) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, req->obj_id);
+
+    //the requests are counted by the shards, a counter shared by all the
+    //threads would be written by every hit
+    if (params->lock_free_hit &&
+        S3Randomsharded_hit_lock_free(params, shard, req)) {
+        S3Randomsharded_warmup_tick(cache);
+        return true;
+    }
+
+    S3Randomsharded_lock(shard);
+    bool cache_hit = shard->cache->get(shard->cache, req);
+    S3Randomsharded_publish(shard);
+    S3Randomsharded_unlock(shard);
+
+    S3Randomsharded_warmup_tick(cache);
+    return cache_hit;
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****       developer facing APIs (used by cache developer)         ****
+// ****                                                               ****
+// ***********************************************************************
+/**
+ * @brief find an object in the shard of the key
+ * the object can be evicted by another thread as soon as the lock of the
+ * shard is released, a concurrent caller should only use the returned
+ * pointer to test for presence
+ */
+static cache_obj_t *S3Randomsharded_find(cache_t *cache, const request_t *req,
+                                         const bool update_cache) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, req->obj_id);
+
+    S3Randomsharded_lock(shard);
+    cache_obj_t *obj = shard->cache->find(shard->cache, req, update_cache);
+    S3Randomsharded_unlock(shard);
+    return obj;
+}
+
+static cache_obj_t *S3Randomsharded_insert(cache_t *cache,
+                                           const request_t *req) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, req->obj_id);
+
+    S3Randomsharded_lock(shard);
+    cache_obj_t *obj = shard->cache->insert(shard->cache, req);
+    S3Randomsharded_publish(shard);
+    S3Randomsharded_unlock(shard);
+    return obj;
+}
+
+static cache_obj_t *S3Randomsharded_to_evict(cache_t *cache,
+                                             const request_t *req) {
+    assert(false);
+    return NULL;
+}
+
+/**
+ * @brief evict from the shard the request goes to, the shards are sized
+ * independently so only that shard needs room
+ */
+static void S3Randomsharded_evict(cache_t *cache, const request_t *req) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, req->obj_id);
+
+    S3Randomsharded_lock(shard);
+    shard->cache->evict(shard->cache, req);
+    S3Randomsharded_publish(shard);
+    S3Randomsharded_unlock(shard);
+}
+
+static bool S3Randomsharded_remove(cache_t *cache, const obj_id_t obj_id) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, obj_id);
+
+    S3Randomsharded_lock(shard);
+    bool removed = shard->cache->remove(shard->cache, obj_id);
+    S3Randomsharded_publish(shard);
+    S3Randomsharded_unlock(shard);
+    return removed;
+}
+
+/**
+ * @brief the sum of the totals published by the shards, it takes no lock
+ * so it can lag behind requests that are being served
+ */
+static inline int64_t S3Randomsharded_get_occupied_byte(const cache_t *cache) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    int64_t occupied_byte = 0;
+    for (int i = 0; i < params->n_shard; i++) {
+        occupied_byte +=
+            __atomic_load_n(&params->shards[i].occupied_byte, __ATOMIC_RELAXED);
+    }
+    return occupied_byte;
+}
+
+static inline int64_t S3Randomsharded_get_n_obj(const cache_t *cache) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    int64_t n_obj = 0;
+    for (int i = 0; i < params->n_shard; i++) {
+        n_obj += __atomic_load_n(&params->shards[i].n_obj, __ATOMIC_RELAXED);
+    }
+    return n_obj;
+}
+
+static inline bool S3Randomsharded_can_insert(cache_t *cache,
+                                              const request_t *req) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    S3Randomsharded_shard_t *shard = S3Randomsharded_shard(params, req->obj_id);
+
+    pthread_mutex_lock(&shard->lock);
+    bool can_insert = shard->cache->can_insert(shard->cache, req);
+    pthread_mutex_unlock(&shard->lock);
+    return can_insert;
+}
+
+/**
+ * @brief the sum of the stats of the shards, each shard is read under its
+ * lock, see S3Random_stats_get
+ */
+void S3Randomsharded_get_stats(const cache_t *cache, S3Random_stats_t *stats) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    memset(stats, 0, sizeof(S3Random_stats_t));
+    for (int i = 0; i < params->n_shard; i++) {
+        S3Randomsharded_shard_t *shard = &params->shards[i];
+        S3Random_stats_t shard_stats;
+        pthread_mutex_lock(&shard->lock);
+        S3Random_stats_get(shard->cache, &shard_stats);
+        pthread_mutex_unlock(&shard->lock);
+
+        int64_t hit_small = __atomic_load_n(
+            &shard->n_lock_free_hit[S3RANDOM_SMALL], __ATOMIC_RELAXED);
+        int64_t hit_main = __atomic_load_n(
+            &shard->n_lock_free_hit[S3RANDOM_MAIN], __ATOMIC_RELAXED);
+        shard_stats.n_hit_small += hit_small;
+        shard_stats.n_hit_main += hit_main;
+        shard_stats.n_req += hit_small + hit_main;
+        S3Random_stats_add(stats, &shard_stats);
+    }
+    //the shards do not count the lock-free hits of the warmup
+    if (S3Random_warmup_enabled(&params->warmup)) {
+        stats->n_warmup_req =
+            __atomic_load_n(&params->warmup.n_done, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief the caches of the shards and their lock-free hit counters, for
+ * S3RandomSnapshot.c
+ *
+ * @return the number of shards
+ */
+int S3Randomsharded_get_shards(const cache_t *cache, cache_t **shards,
+                               int64_t **n_lock_free_hit) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    for (int i = 0; i < params->n_shard; i++) {
+        shards[i] = params->shards[i].cache;
+        n_lock_free_hit[i] = params->shards[i].n_lock_free_hit;
+    }
+    return params->n_shard;
+}
+
+/**
+ * @brief take the locks of all the shards in order, or publish the shards
+ * and release them, so a snapshot sees each shard between two requests
+ */
+void S3Randomsharded_lock_all(cache_t *cache, const bool lock) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    for (int i = 0; i < params->n_shard; i++) {
+        S3Randomsharded_shard_t *shard = &params->shards[i];
+        if (lock) {
+            S3Randomsharded_lock(shard);
+        } else {
+            S3Randomsharded_publish(shard);
+            S3Randomsharded_unlock(shard);
+        }
+    }
+}
+
+// ***********************************************************************
+// ****                                                               ****
+// ****                  parameter set up functions                   ****
+// ****                                                               ****
+// ***********************************************************************
+static void S3Randomsharded_parse_params(cache_t *cache,
+                                         const char *cache_specific_params) {
+    S3Randomsharded_params_t *params =
+        (S3Randomsharded_params_t *)cache->eviction_params;
+    char *params_str = strdup(cache_specific_params);
+    char *old_params_str = params_str;
+    //lock-free hits do not feed the promoted hits of the adaptive split
+    bool shard_needs_lock = false;
+
+    while (params_str != NULL && params_str[0] != '\0') {
+        /* different parameters are separated by comma,
+         * key and value are separated by = */
+        char *key = strsep((char **)&params_str, "=");
+        char *value = strsep((char **)&params_str, ",");
+
+        // skip the white space
+        while (params_str != NULL && *params_str == ' ') {
+            params_str++;
+        }
+
+        if (value == NULL) {
+            ERROR("%s parameter %s has no value\n", cache->cache_name, key);
+            exit(1);
+        } else if (strcasecmp(key, "n-shard") == 0) {
+            params->n_shard = atoi(value);
+            if (params->n_shard < 1 ||
+                params->n_shard > S3RANDOMSHARDED_MAX_SHARD) {
+                ERROR("%s n-shard must be in [1, %d]\n", cache->cache_name,
+                      S3RANDOMSHARDED_MAX_SHARD);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "algo") == 0) {
+            if (strcasecmp(value, "S3Random") != 0 &&
+                strcasecmp(value, "S3Randomtwo") != 0 &&
+                strcasecmp(value, "S3Randomfreq") != 0) {
+                ERROR("%s does not support algo %s\n", cache->cache_name,
+                      value);
+                exit(1);
+            }
+            strncpy(params->algo, value, sizeof(params->algo) - 1);
+        } else if (strcasecmp(key, "lock-free-hit") == 0) {
+            params->lock_free_hit = atoi(value) != 0;
+        } else if (strcasecmp(key, "seed") == 0) {
+            params->seed = strtoull(value, NULL, 10);
+        } else if (strcasecmp(key, "warmup") == 0) {
+            params->warmup.n_req = strtoll(value, NULL, 10);
+            if (params->warmup.n_req < 0) {
+                ERROR("%s warmup must be >= 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else if (strcasecmp(key, "warmup-sec") == 0) {
+            params->warmup.sec = strtod(value, NULL);
+            if (params->warmup.sec < 0) {
+                ERROR("%s warmup-sec must be >= 0\n", cache->cache_name);
+                exit(1);
+            }
+        } else {
+            if (strcasecmp(key, "adaptive") == 0 && atoi(value) != 0) {
+                shard_needs_lock = true;
+            }
+            //the shards parse the rest
+            size_t len = strlen(params->shard_params);
+            int n = snprintf(params->shard_params + len,
+                             sizeof(params->shard_params) - len, "%s%s=%s",
+                             len == 0 ? "" : ",", key, value);
+            if (n < 0 || (size_t)n >= sizeof(params->shard_params) - len) {
+                ERROR("%s parameters of the shards are too long\n",
+                      cache->cache_name);
+                exit(1);
+            }
+        }
+    }
+
+    free(old_params_str);
+
+    if (shard_needs_lock) {
+        params->lock_free_hit = false;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif